@@ -0,0 +1,129 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the ComponentTree class */
+#include <gtest/gtest.h>
+
+#include "ComponentTree.cpp"
+
+class ComponentTreeTest : public ::testing::Test {
+ protected:
+   // 5 proteins, each a group of its own, and PSMs joining 0-1 (0.9),
+   // 1-2 (0.5), 3-4 (0.7) and 2-3 (0.1), and one PSM of protein 0 alone
+   virtual void SetUp() {
+     vector<pair<int, int> > edges;
+     edges.push_back(make_pair(0, 0));
+     edges.push_back(make_pair(0, 1));
+     edges.push_back(make_pair(1, 1));
+     edges.push_back(make_pair(1, 2));
+     edges.push_back(make_pair(2, 3));
+     edges.push_back(make_pair(2, 4));
+     edges.push_back(make_pair(3, 2));
+     edges.push_back(make_pair(3, 3));
+     edges.push_back(make_pair(4, 0));
+     graph = CompressedBigraph(5, 5, edges);
+
+     double weights[] = { 0.9, 0.5, 0.7, 0.1, 0.8 };
+     psmWeights.assign(weights, weights + 5);
+     for (int k = 0; k < 5; k++) groups.push_back(vector<int>(1, k));
+   }
+   virtual void TearDown() {}
+
+   vector<int> proteinsOf(const ComponentTree & tree, int node) {
+     vector<int> proteins;
+     for (int k = tree.proteinsBegin(node); k < tree.proteinsEnd(node); k++) {
+       proteins.push_back(tree.proteinsOrder(k));
+     }
+     sort(proteins.begin(), proteins.end());
+     return proteins;
+   }
+
+   CompressedBigraph graph;
+   vector<double> psmWeights;
+   vector<vector<int> > groups;
+};
+
+TEST_F(ComponentTreeTest, UnionsInOrderOfDescendingWeight){
+  // the PSM of weight 0.1 is at or below minWeight and never joins 2 and 3
+  ComponentTree tree(graph, psmWeights, groups, 0.2);
+  EXPECT_EQ(5, tree.numLeaves());
+  ASSERT_EQ(8, tree.numNodes());
+
+  // 0-1 first, then 3-4, then {0, 1} with 2
+  EXPECT_EQ(0, tree.left(5));
+  EXPECT_EQ(1, tree.right(5));
+  EXPECT_DOUBLE_EQ(0.9, tree.weight(5));
+  EXPECT_EQ(3, tree.left(6));
+  EXPECT_EQ(4, tree.right(6));
+  EXPECT_DOUBLE_EQ(0.7, tree.weight(6));
+  EXPECT_EQ(5, tree.left(7));
+  EXPECT_EQ(2, tree.right(7));
+  EXPECT_DOUBLE_EQ(0.5, tree.weight(7));
+
+  EXPECT_EQ(7, tree.parent(5));
+  EXPECT_EQ(7, tree.parent(2));
+  EXPECT_EQ(6, tree.parent(3));
+  EXPECT_EQ(-1, tree.parent(6));
+  EXPECT_EQ(-1, tree.parent(7));
+  EXPECT_TRUE(tree.isLeaf(4));
+  EXPECT_FALSE(tree.isLeaf(5));
+
+  EXPECT_EQ(0, tree.minProtein(7));
+  EXPECT_EQ(3, tree.minProtein(6));
+  int proteins7[] = { 0, 1, 2 };
+  EXPECT_EQ(vector<int>(proteins7, proteins7 + 3), proteinsOf(tree, 7));
+  int proteins6[] = { 3, 4 };
+  EXPECT_EQ(vector<int>(proteins6, proteins6 + 2), proteinsOf(tree, 6));
+}
+
+TEST_F(ComponentTreeTest, LowThresholdJoinsAllProteins){
+  // with the PSM of weight 0.1 included, everything is one component
+  ComponentTree tree(graph, psmWeights, groups, 0.0);
+  ASSERT_EQ(9, tree.numNodes());
+  EXPECT_EQ(-1, tree.parent(8));
+  EXPECT_DOUBLE_EQ(0.1, tree.weight(8));
+  EXPECT_EQ(5, tree.proteinsEnd(8) - tree.proteinsBegin(8));
+}
+
+TEST_F(ComponentTreeTest, ComponentsAtThreshold){
+  ComponentTree tree(graph, psmWeights, groups, 0.2);
+  vector<int> result;
+
+  tree.components(7, 0.4, result);
+  ASSERT_EQ(1u, result.size());
+  EXPECT_EQ(7, result[0]);
+
+  // PSMs of weight 0.5 no longer join, those of 0.9 still do
+  result.clear();
+  tree.components(7, 0.5, result);
+  ASSERT_EQ(2u, result.size());
+  EXPECT_EQ(5, result[0]);
+  EXPECT_EQ(2, result[1]);
+
+  // the components are appended to the result
+  tree.components(6, 0.7, result);
+  ASSERT_EQ(4u, result.size());
+  EXPECT_EQ(3, result[2]);
+  EXPECT_EQ(4, result[3]);
+
+  // leaves stay whole at any threshold
+  result.clear();
+  tree.components(7, 1.0, result);
+  ASSERT_EQ(3u, result.size());
+  EXPECT_EQ(0, result[0]);
+  EXPECT_EQ(1, result[1]);
+  EXPECT_EQ(2, result[2]);
+}
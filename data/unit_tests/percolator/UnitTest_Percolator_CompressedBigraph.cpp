@@ -0,0 +1,133 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the CompressedBigraph class */
+#include <gtest/gtest.h>
+
+#include "CompressedBigraph.cpp"
+
+class CompressedBigraphTest : public ::testing::Test {
+ protected:
+   // 4 PSMs and 4 proteins; the edges are out of order and (1, 2) is given
+   // twice. Proteins 0 and 3 have the same PSMs.
+   virtual void SetUp() {
+     edges.push_back(make_pair(1, 2));
+     edges.push_back(make_pair(0, 3));
+     edges.push_back(make_pair(2, 1));
+     edges.push_back(make_pair(0, 0));
+     edges.push_back(make_pair(1, 2));
+     edges.push_back(make_pair(1, 0));
+     edges.push_back(make_pair(1, 3));
+     edges.push_back(make_pair(3, 1));
+     graph = CompressedBigraph(4, 4, edges);
+   }
+   virtual void TearDown() {}
+
+   vector<pair<int, int> > edges;
+   CompressedBigraph graph;
+};
+
+TEST_F(CompressedBigraphTest, BuildSortsAndRemovesDuplicateEdges){
+  EXPECT_EQ(4, graph.numPSMs());
+  EXPECT_EQ(4, graph.numProteins());
+  EXPECT_EQ(7, graph.numEdges());
+
+  int psmDegrees[] = { 2, 3, 1, 1 };
+  int psmProteins[][3] = { { 0, 3 }, { 0, 2, 3 }, { 1 }, { 1 } };
+  for (int psm = 0; psm < 4; psm++) {
+    ASSERT_EQ(psmDegrees[psm], graph.psmDegree(psm));
+    for (int j = 0; j < graph.psmDegree(psm); j++) {
+      EXPECT_EQ(psmProteins[psm][j], graph.proteinOfPSM(psm, j));
+    }
+  }
+
+  int proteinDegrees[] = { 2, 2, 1, 2 };
+  int proteinPSMs[][2] = { { 0, 1 }, { 2, 3 }, { 1 }, { 0, 1 } };
+  for (int protein = 0; protein < 4; protein++) {
+    ASSERT_EQ(proteinDegrees[protein], graph.proteinDegree(protein));
+    for (int j = 0; j < graph.proteinDegree(protein); j++) {
+      EXPECT_EQ(proteinPSMs[protein][j], graph.psmOfProtein(protein, j));
+    }
+  }
+}
+
+TEST_F(CompressedBigraphTest, NodesWithoutEdges){
+  CompressedBigraph empty(2, 3, vector<pair<int, int> >());
+  EXPECT_EQ(2, empty.numPSMs());
+  EXPECT_EQ(3, empty.numProteins());
+  EXPECT_EQ(0, empty.numEdges());
+  EXPECT_EQ(0, empty.psmDegree(1));
+  EXPECT_EQ(0, empty.proteinDegree(2));
+}
+
+TEST_F(CompressedBigraphTest, SubgraphRenumbersKeptNodes){
+  // drop PSM 1 and protein 1
+  bool keepPSMs[] = { true, false, true, true };
+  bool keepProteins[] = { true, false, true, true };
+  CompressedBigraph sub = graph.subgraph(vector<bool>(keepPSMs, keepPSMs + 4),
+      vector<bool>(keepProteins, keepProteins + 4));
+
+  EXPECT_EQ(3, sub.numPSMs());
+  EXPECT_EQ(3, sub.numProteins());
+  EXPECT_EQ(2, sub.numEdges());
+  // old PSM 0 keeps old proteins 0 and 3, now 0 and 2
+  ASSERT_EQ(2, sub.psmDegree(0));
+  EXPECT_EQ(0, sub.proteinOfPSM(0, 0));
+  EXPECT_EQ(2, sub.proteinOfPSM(0, 1));
+  // old PSMs 2 and 3 only had protein 1
+  EXPECT_EQ(0, sub.psmDegree(1));
+  EXPECT_EQ(0, sub.psmDegree(2));
+  // old protein 2 only had PSM 1
+  EXPECT_EQ(0, sub.proteinDegree(1));
+  ASSERT_EQ(1, sub.proteinDegree(2));
+  EXPECT_EQ(0, sub.psmOfProtein(2, 0));
+}
+
+TEST_F(CompressedBigraphTest, ProteinReplicates){
+  vector<vector<int> > groups;
+  graph.proteinReplicates(groups);
+  ASSERT_EQ(3u, groups.size());
+  ASSERT_EQ(2u, groups[0].size());
+  EXPECT_EQ(0, groups[0][0]);
+  EXPECT_EQ(3, groups[0][1]);
+  ASSERT_EQ(1u, groups[1].size());
+  EXPECT_EQ(1, groups[1][0]);
+  ASSERT_EQ(1u, groups[2].size());
+  EXPECT_EQ(2, groups[2][0]);
+}
+
+TEST_F(CompressedBigraphTest, MarkSectionsStopsAtLowWeightPSMs){
+  vector<int> proteinSections, psmSections;
+  vector<bool> multipleSections;
+
+  // all PSMs are followed: proteins 0, 2 and 3 share PSM 1
+  double highWeights[] = { 0.9, 0.9, 0.9, 0.9 };
+  EXPECT_EQ(2, graph.markSections(vector<double>(highWeights, highWeights + 4),
+      0.5, proteinSections, psmSections, multipleSections));
+  EXPECT_EQ(proteinSections[0], proteinSections[2]);
+  EXPECT_EQ(proteinSections[0], proteinSections[3]);
+  EXPECT_NE(proteinSections[0], proteinSections[1]);
+
+  // PSM 1 is not followed, so protein 2 is a section of its own, but
+  // replicates 0 and 3 stay together; PSM 1 is reached from both sections
+  double lowWeights[] = { 0.9, 0.1, 0.9, 0.9 };
+  EXPECT_EQ(3, graph.markSections(vector<double>(lowWeights, lowWeights + 4),
+      0.5, proteinSections, psmSections, multipleSections));
+  EXPECT_EQ(proteinSections[0], proteinSections[3]);
+  EXPECT_NE(proteinSections[0], proteinSections[2]);
+  EXPECT_TRUE(multipleSections[1]);
+  EXPECT_FALSE(multipleSections[0]);
+}
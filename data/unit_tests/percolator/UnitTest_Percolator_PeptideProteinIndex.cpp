@@ -0,0 +1,174 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/* This file include test cases for the PeptideProteinIndex class */
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "fisher/PeptideProteinIndex.cpp"
+
+class PeptideProteinIndexTest : public ::testing::Test {
+ protected:
+   // the peptides of 6 proteins; some are shared, and protein 4 contains
+   // "PEPTIDE" twice
+   virtual void SetUp() {
+     const char* peptides[][3] = {
+       { "PEPTIDE", "SAMPLER", "K" },
+       { "SAMPLER", "LVQGK", "AK" },
+       { "PEPTIDE", "AK", "MMMR" },
+       { "LVQGK", "SAMPLERS", "PEPTIDES" },
+       { "PEPTIDE", "AK", "PEPTIDE" },
+       { "MMMR", "K", "SAMPLE" }
+     };
+     for (size_t protein = 0; protein < 6; ++protein) {
+       proteinPeptides.push_back(std::vector<std::string>(
+           peptides[protein], peptides[protein] + 3));
+     }
+   }
+   virtual void TearDown() {}
+
+   void addProteins(PeptideProteinIndex& index, size_t begin, size_t end) {
+     for (size_t protein = begin; protein < end; ++protein) {
+       for (size_t k = 0; k < proteinPeptides[protein].size(); ++k) {
+         const std::string& peptide = proteinPeptides[protein][k];
+         index.add(peptide.data(), peptide.size(), protein);
+       }
+     }
+   }
+
+   int find(const PeptideProteinIndex& index, const std::string& peptide) {
+     return index.find(peptide.data(), peptide.size());
+   }
+
+   std::vector<unsigned int> proteinsOf(const PeptideProteinIndex& index,
+                                        const std::string& peptide) {
+     int idx = find(index, peptide);
+     return std::vector<unsigned int>(index.proteinsBegin(idx),
+                                      index.proteinsEnd(idx));
+   }
+
+   std::vector<std::vector<std::string> > proteinPeptides;
+};
+
+TEST_F(PeptideProteinIndexTest, ProteinListsOfPeptides){
+  PeptideProteinIndex index;
+  addProteins(index, 0, 6);
+  index.finalize();
+
+  EXPECT_EQ(9u, index.getNumPeptides());
+  // peptides are numbered in the order they are first added
+  EXPECT_EQ(0, find(index, "PEPTIDE"));
+  EXPECT_EQ(1, find(index, "SAMPLER"));
+  EXPECT_EQ(8, find(index, "SAMPLE"));
+
+  unsigned int peptide[] = { 0, 2, 4, 4 };
+  EXPECT_EQ(std::vector<unsigned int>(peptide, peptide + 4),
+            proteinsOf(index, "PEPTIDE"));
+  unsigned int ak[] = { 1, 2, 4 };
+  EXPECT_EQ(std::vector<unsigned int>(ak, ak + 3), proteinsOf(index, "AK"));
+  unsigned int samplers[] = { 3 };
+  EXPECT_EQ(std::vector<unsigned int>(samplers, samplers + 1),
+            proteinsOf(index, "SAMPLERS"));
+}
+
+TEST_F(PeptideProteinIndexTest, NotFound){
+  // a copy, as the EXPECT macros take their arguments by reference
+  const int kNotFound = PeptideProteinIndex::kNotFound;
+  PeptideProteinIndex empty;
+  empty.finalize();
+  EXPECT_EQ(0u, empty.getNumPeptides());
+  EXPECT_EQ(kNotFound, find(empty, "PEPTIDE"));
+  EXPECT_EQ(kNotFound, find(empty, ""));
+
+  PeptideProteinIndex index;
+  addProteins(index, 0, 6);
+  index.finalize();
+  // prefixes, extensions and other peptides are not found
+  EXPECT_EQ(kNotFound, find(index, "PEPTID"));
+  EXPECT_EQ(kNotFound, find(index, "PEPTIDEK"));
+  EXPECT_EQ(kNotFound, find(index, "QVGLK"));
+  EXPECT_EQ(kNotFound, find(index, ""));
+  // a sequence is matched on its length, not on a terminating character
+  const char* sampler = "SAMPLERS";
+  EXPECT_EQ(find(index, "SAMPLE"), index.find(sampler, 6));
+  EXPECT_EQ(find(index, "SAMPLER"), index.find(sampler, 7));
+}
+
+TEST_F(PeptideProteinIndexTest, AppendEqualsSingleIndex){
+  PeptideProteinIndex single;
+  addProteins(single, 0, 6);
+  single.finalize();
+
+  // consecutive blocks of proteins indexed separately, as in the parallel
+  // digestion, then appended in order
+  PeptideProteinIndex appended, first, second, third;
+  addProteins(first, 0, 2);
+  addProteins(second, 2, 5);
+  addProteins(third, 5, 6);
+  appended.append(first);
+  appended.append(second);
+  appended.append(third);
+  appended.finalize();
+
+  ASSERT_EQ(single.getNumPeptides(), appended.getNumPeptides());
+  for (size_t protein = 0; protein < proteinPeptides.size(); ++protein) {
+    for (size_t k = 0; k < proteinPeptides[protein].size(); ++k) {
+      const std::string& peptide = proteinPeptides[protein][k];
+      EXPECT_EQ(find(single, peptide), find(appended, peptide));
+      EXPECT_EQ(proteinsOf(single, peptide), proteinsOf(appended, peptide));
+    }
+  }
+}
+
+TEST_F(PeptideProteinIndexTest, FinalizeSortsProteinsAddedOutOfOrder){
+  PeptideProteinIndex index;
+  index.add("PEPTIDE", 7, 5);
+  index.add("PEPTIDE", 7, 1);
+  index.add("SAMPLER", 7, 5);
+  index.add("PEPTIDE", 7, 3);
+  index.add("PEPTIDE", 7, 1);
+  index.finalize();
+
+  unsigned int peptide[] = { 1, 1, 3, 5 };
+  EXPECT_EQ(std::vector<unsigned int>(peptide, peptide + 4),
+            proteinsOf(index, "PEPTIDE"));
+}
+
+TEST_F(PeptideProteinIndexTest, ManyPeptides){
+  // enough peptides for the hash table to grow several times
+  PeptideProteinIndex index;
+  for (size_t k = 0; k < 5000; ++k) {
+    std::ostringstream peptide;
+    peptide << "PEP" << k << "K";
+    index.add(peptide.str().data(), peptide.str().size(), k % 7);
+  }
+  index.finalize();
+
+  ASSERT_EQ(5000u, index.getNumPeptides());
+  for (size_t k = 0; k < 5000; ++k) {
+    std::ostringstream peptide;
+    peptide << "PEP" << k << "K";
+    int idx = find(index, peptide.str());
+    ASSERT_EQ(static_cast<int>(k), idx);
+    ASSERT_EQ(1, index.proteinsEnd(idx) - index.proteinsBegin(idx));
+    EXPECT_EQ(k % 7, *index.proteinsBegin(idx));
+  }
+  EXPECT_TRUE(find(index, "PEP5000K") == PeptideProteinIndex::kNotFound);
+}
@@ -24,6 +24,9 @@
  */
 
 #include "UnitTest_Percolator_Fido.cpp"
+#include "UnitTest_Percolator_CompressedBigraph.cpp"
+#include "UnitTest_Percolator_ComponentTree.cpp"
+#include "UnitTest_Percolator_PeptideProteinIndex.cpp"
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
@@ -259,6 +259,10 @@ bool Caller::parseOptions(int argc, char **argv) {
       "Type of enzyme \"no_enzyme\",\"elastase\",\"pepsin\",\"proteinasek\",\"thermolysin\",\"trypsinp\",\"chymotrypsin\",\"lys-n\",\"lys-c\",\"arg-c\",\"asp-n\",\"glu-c\",\"trypsin\" default=\"trypsin\"",
       "",
       "trypsin");
+  cmd.defineOption("",
+      "protein-digest-cache",
+      "Directory in which the protein fragments and duplicates found by the in-silico digest of the fasta file are kept. Later runs on the same fasta file with the same digestion settings read them from there instead of digesting the database again. Default = no cache.",
+      "directory");
   /*cmd.defineOption("Q",
       "fisher-pval-cutoff",
       "The p-value cutoff for peptides when inferring proteins with fisher's method. Default = 1.0",
@@ -321,6 +325,19 @@ bool Caller::parseOptions(int argc, char **argv) {
       "fido-protein-truncation-threshold",
       "To speed up inference, proteins for which none of the associated peptides has a probability exceeding the specified threshold will be assigned probability = 0. Default = 0.01.",
       "value");
+  cmd.defineOption("",
+      "fido-approximation-threshold",
+      "Instead of splitting graph components with more than 2^value possible configurations, infer their protein probabilities approximately with loopy belief propagation. Default = 0 (exact inference only); Recommended when set = 18.",
+      "value");
+  cmd.defineOption("",
+      "fido-coarse-gridsearch",
+      "Search grids of more than 500 points (depth 4) on every third value of alpha, beta and gamma first, and then at full resolution around the best of these points. Faster, but the parameters found can differ from those of the exhaustive search. Default = exhaustive grid search.",
+      "",
+      TRUE_IF_SET);
+  cmd.defineOption("",
+      "fido-budget",
+      "Share a total of 2^value configurations between the graph components instead of allowing 2^18 configurations in each of them. Components that fit in an equal share keep their full size, the larger ones are split down to the share that remains. Larger values give more exact probabilities, smaller values a shorter run time. Default = 0 (2^18 per component).",
+      "value");
   cmd.defineOption("H",
       "fido-gridsearch-mse-threshold",
       "Q-value threshold that will be used in the computation of the MSE and ROC AUC score in the grid search. Recommended 0.05 for normal size datasets and 0.1 for big size datasets. Default = 0.1",
@@ -439,18 +456,26 @@ bool Caller::parseOptions(int argc, char **argv) {
       double fidoGridSearchThreshold = 0.0;
       double fidoProteinThreshold = 0.01;
       double fidoMseThreshold = 0.1;
+      double fidoApproximationThreshold = 0.0;
+      double fidoConfigurationBudget = 0.0;
+      bool fidoCoarseGridSearch = false;
       if (cmd.optionSet("d")) fidoGridSearchDepth = cmd.getInt("d", 0, 4);
       if (cmd.optionSet("T")) fidoGridSearchThreshold = cmd.getDouble("T", 0.0, 1.0);
       if (cmd.optionSet("C")) fidoNoPruning = true;
       if (cmd.optionSet("E")) fidoProteinThreshold = cmd.getDouble("E", 0.0, 1.0);
       if (cmd.optionSet("H")) fidoMseThreshold = cmd.getDouble("H",0.001,1.0);
+      if (cmd.optionSet("fido-approximation-threshold")) fidoApproximationThreshold = cmd.getDouble("fido-approximation-threshold", 0.0, 1000.0);
+      if (cmd.optionSet("fido-budget")) fidoConfigurationBudget = cmd.getDouble("fido-budget", 0.0, 1000.0);
+      if (cmd.optionSet("fido-coarse-gridsearch")) fidoCoarseGridSearch = true;
       
       protEstimator_ = new FidoInterface(fidoAlpha, fidoBeta, fidoGamma, 
                 fidoNoClustering, fidoNoPartitioning, fidoNoPruning,
                 fidoGridSearchDepth, fidoGridSearchThreshold,
                 fidoProteinThreshold, fidoMseThreshold,
                 protEstimatorAbsenceRatio, protEstimatorOutputEmpirQVal, 
-                protEstimatorDecoyPrefix, protEstimatorTrivialGrouping);
+                protEstimatorDecoyPrefix, protEstimatorTrivialGrouping,
+                fidoApproximationThreshold, fidoConfigurationBudget,
+                fidoCoarseGridSearch);
     } else if (cmd.optionSet("f")) {  
       std::string fastaDatabase = cmd.options["f"];
       
@@ -458,17 +483,22 @@ bool Caller::parseOptions(int argc, char **argv) {
       double fisherPvalueCutoff = 1.0;
       bool fisherReportFragmentProteins = false;
       bool fisherReportDuplicateProteins = false;
+      std::string fisherDigestCacheDirectory = "";
       if (cmd.optionSet("z")) {
         Enzyme::setEnzyme(cmd.options["z"]);
       }      
       //if (cmd.optionSet("Q")) fisherPvalueCutoff = cmd.getDouble("Q", 0.0, 1.0);
       if (cmd.optionSet("c")) fisherReportFragmentProteins = true;
       if (cmd.optionSet("g")) fisherReportDuplicateProteins = true;
+      if (cmd.optionSet("protein-digest-cache")) {
+        fisherDigestCacheDirectory = cmd.options["protein-digest-cache"];
+      }
       
       protEstimator_ = new FisherInterface(fastaDatabase, fisherPvalueCutoff,
           fisherReportFragmentProteins, fisherReportDuplicateProteins,
           protEstimatorTrivialGrouping, protEstimatorAbsenceRatio, 
-          protEstimatorOutputEmpirQVal, protEstimatorDecoyPrefix);
+          protEstimatorOutputEmpirQVal, protEstimatorDecoyPrefix, 
+          fisherDigestCacheDirectory);
     }
   }
   
@@ -487,7 +517,7 @@ bool Caller::parseOptions(int argc, char **argv) {
     inputFN_ = cmd.options["j"];
   }
   
-  if (cmd.optionSet("")) {
+  if (cmd.optionSet("stdinput")) {
     readStdIn_ = true;
     tabInput_ = true;
   }
@@ -571,7 +601,7 @@ bool Caller::parseOptions(int argc, char **argv) {
   }
   // if there are no arguments left...
   if (cmd.arguments.size() == 0) {
-    if(!cmd.optionSet("j") && !cmd.optionSet("k") && !cmd.optionSet("e") && !cmd.optionSet("")){ // unless the input comes from -j, -k or -e option
+    if(!cmd.optionSet("j") && !cmd.optionSet("k") && !cmd.optionSet("e") && !cmd.optionSet("stdinput")){ // unless the input comes from -j, -k or -e option
       cerr << "Error: too few arguments.";
       cerr << "\nInvoke with -h option for help\n";
       return 0; // ...error
@@ -586,7 +616,7 @@ bool Caller::parseOptions(int argc, char **argv) {
       cerr << "\nInvoke with -h option for help.\n";
       return 0; // ...error
     }
-    if (cmd.optionSet("e") || cmd.optionSet("")){ // if stdin pin file is present
+    if (cmd.optionSet("e") || cmd.optionSet("stdinput")){ // if stdin pin file is present
       cerr << "Error: the pin file has already been given as stdinput argument.";
       cerr << "\nInvoke with -h option for help.\n";
       return 0; // ...error
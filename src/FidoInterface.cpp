@@ -78,13 +78,18 @@ FidoInterface::FidoInterface(double alpha, double beta, double gamma,
     unsigned gridSearchDepth, double gridSearchThreshold, 
     double proteinThreshold, double mseThreshold, 
     double absenceRatio, bool outputEmpirQVal, 
-    std::string decoyPattern, bool trivialGrouping) :
+    std::string decoyPattern, bool trivialGrouping, 
+    double approximationThreshold, double configurationBudget,
+    bool coarseGridSearch) :
   ProteinProbEstimator(trivialGrouping, absenceRatio, outputEmpirQVal, decoyPattern), 
   alpha_(alpha), beta_(beta), gamma_(gamma),
   noPartitioning_(noPartitioning), noClustering_(noClustering),
   noPruning_(noPruning), proteinThreshold_(proteinThreshold), 
+  approximationThreshold_(approximationThreshold), 
+  configurationBudget_(configurationBudget), 
   gridSearchDepth_(gridSearchDepth), 
-  gridSearchThreshold_(gridSearchThreshold), mseThreshold_(mseThreshold),
+  gridSearchThreshold_(gridSearchThreshold), 
+  coarseGridSearch_(coarseGridSearch), mseThreshold_(mseThreshold),
   doGridSearch_(false), rocN_(kDefaultRocN) {}
       
 FidoInterface::~FidoInterface() {  
@@ -112,6 +117,8 @@ void FidoInterface::run() {
   proteinGraph_ = new GroupPowerBigraph(alpha_, beta_, gamma_, noClustering_, noPartitioning_, noPruning_, trivialGrouping_);
   proteinGraph_->setMaxAllowedConfigurations(LOG_MAX_ALLOWED_CONFIGURATIONS);
   proteinGraph_->setPeptidePrior(localPeptidePrior);
+  proteinGraph_->setApproximationThreshold(approximationThreshold_);
+  proteinGraph_->setConfigurationBudget(configurationBudget_);
   
   if (gridSearchThreshold_ > 0.0 && doGridSearch_) {
     //NOTE lets create a smaller tree to estimate the parameters faster
@@ -135,19 +142,36 @@ void FidoInterface::run() {
  
 }
 
-void FidoInterface::updateTargetDecoySizes() {
+/*
+* The protein names of the groups are only matched against the decoy pattern
+* once per graph; the grid search objective then works on the counts, indexed
+* by the group order of the ranking.
+*/
+void FidoInterface::labelProteinGroups() {
   std::vector<std::vector<std::string> > proteinNames;
   proteinGraph_->getProteinNames(proteinNames);
   
-  numberTargetProteins_ = 0;
-  numberDecoyProteins_ = 0;
+  groupTargets_.resize(proteinNames.size());
+  groupDecoys_.resize(proteinNames.size());
   for (unsigned int k = 0; k < proteinNames.size(); ++k) {
     unsigned tpChange = countTargets(proteinNames[k]);
     unsigned fpChange = proteinNames[k].size() - tpChange;
+    //if ties activated count groups as 1 protein
     if (trivialGrouping_) {
-      if (tpChange > 0) numberTargetProteins_ += 1;
-      if (fpChange > 0) numberDecoyProteins_ += 1;
+      if (tpChange > 0) tpChange = 1;
+      if (fpChange > 0) fpChange = 1;
     }
+    groupTargets_[k] = tpChange;
+    groupDecoys_[k] = fpChange;
+  }
+}
+
+void FidoInterface::updateTargetDecoySizes() {
+  numberTargetProteins_ = 0;
+  numberDecoyProteins_ = 0;
+  for (unsigned int k = 0; k < groupTargets_.size(); ++k) {
+    numberTargetProteins_ += groupTargets_[k];
+    numberDecoyProteins_ += groupDecoys_[k];
   }
 }
 
@@ -160,6 +184,7 @@ void FidoInterface::computeProbabilities(const std::string& fname) {
     proteinGraph_->read(peptideScores_);
   }
   
+  labelProteinGroups();
   if (trivialGrouping_) updateTargetDecoySizes();
   
   time_t startTime;
@@ -217,13 +242,40 @@ void FidoInterface::computeProbabilities(const std::string& fname) {
     } else {
       proteinGraph_->read(peptideScores_);
     }
+    labelProteinGroups();
     if (trivialGrouping_) updateTargetDecoySizes();
   }
   
   proteinGraph_->setAlphaBetaGamma(alpha_, beta_, gamma_);
   proteinGraph_->getProteinProbs();
-  pepProteinMap_.clear();
-  proteinGraph_->getProteinProbsPercolator(pepProteinMap_);
+  std::multimap<double, std::vector<std::string> > pepProteinMap;
+  proteinGraph_->getProteinProbsPercolator(pepProteinMap);
+  rankProteinGroups(pepProteinMap);
+}
+
+/*
+* The protein groups of the graph are named by their proteins; the names are 
+* looked up once to rank the groups by protein id. Proteins that were not 
+* read from the PSMs, i.e. when the graph was read from a file, are added.
+*/
+void FidoInterface::rankProteinGroups(
+    const std::multimap<double, std::vector<std::string> > &pepProteinMap) {
+  clearRankedGroups();
+  std::vector<int> proteinIds;
+  std::multimap<double, std::vector<std::string> >::const_iterator it;
+  for (it = pepProteinMap.begin(); it != pepProteinMap.end(); it++) {
+    proteinIds.clear();
+    for (size_t k = 0; k < it->second.size(); ++k) {
+      const std::string& proteinName = it->second[k];
+      int proteinId = proteinIndex_.find(proteinName);
+      if (proteinId == ProteinIdIndex::kNotFound) {
+        proteinId = addProtein(proteinName, new Protein(proteinName, 
+            isDecoy(proteinName), NULL, proteins_.size() + 1));
+      }
+      proteinIds.push_back(proteinId);
+    }
+    addRankedGroup(it->first, proteinIds);
+  }
 }
 
 void FidoInterface::gridSearch() {
@@ -347,55 +399,142 @@ void FidoInterface::gridSearchOptimize() {
   gridSearch(alpha_search, beta_search, gamma_search);
 }
 
+// indices of the grid points along one axis: every stride-th point (and the
+// last one) within radius of center, or the whole axis if radius == 0
+static void gridAxisIndices(size_t n, size_t stride, size_t center,
+                            size_t radius, std::vector<size_t>& indices) {
+  indices.clear();
+  size_t lower = 0, upper = n - 1;
+  if (radius > 0) {
+    lower = (center > radius) ? center - radius : 0;
+    upper = std::min(center + radius, n - 1);
+  }
+  for (size_t i = lower; i <= upper; i += stride) {
+    indices.push_back(i);
+  }
+  if (indices.back() != upper) indices.push_back(upper);
+}
+
 void FidoInterface::gridSearch(std::vector<double>& alpha_search, 
     std::vector<double>& beta_search, 
     std::vector<double>& gamma_search) {
-  double gamma_best = -1.0, alpha_best = -1.0, beta_best = -1.0;
-  double best_objective = -100000000;
-  double current_objective;
-  
-  for (unsigned int i = 0; i < gamma_search.size(); i++) {
-    double gamma_local = gamma_search[i];
-    for (unsigned int j = 0; j < alpha_search.size(); j++) {
-      double alpha_local = alpha_search[j];
-      for (unsigned int k = 0; k < beta_search.size(); k++) {
-        double beta_local = beta_search[k];
-        
-        current_objective = calcObjective(alpha_local, beta_local, gamma_local);
-        if (current_objective > best_objective) {
-          best_objective = current_objective;
-          gamma_best = gamma_local;
-          alpha_best = alpha_local;
-          beta_best = beta_local;
+  size_t numGamma = gamma_search.size(), numAlpha = alpha_search.size(), 
+         numBeta = beta_search.size();
+  size_t numPoints = numGamma * numAlpha * numBeta;
+  if (numPoints == 0) {
+    alpha_ = beta_ = gamma_ = -1.0;
+    return;
+  }
+  
+  // grids are searched exhaustively, unless a coarse grid search was requested
+  // for a large grid; it is then first searched on a coarse grid and then at
+  // full resolution around the coarse optimum
+  size_t stride = 1u;
+  if (coarseGridSearch_ && numPoints > kMaxFullGridPoints) {
+    stride = kCoarseGridStride;
+  }
+  
+  std::vector<double> objective(numPoints, 0.0);
+  std::vector<bool> evaluated(numPoints, false);
+  size_t bestIdx = 0;
+  size_t numRounds = (stride > 1) ? 2 : 1;
+  for (size_t round = 0; round < numRounds; ++round) {
+    size_t step = stride, radius = 0;
+    if (round > 0) {
+      step = 1;
+      radius = stride - 1;
+    }
+    std::vector<size_t> gammaIdx, alphaIdx, betaIdx;
+    gridAxisIndices(numGamma, step, bestIdx / (numAlpha * numBeta), radius, gammaIdx);
+    gridAxisIndices(numAlpha, step, (bestIdx / numBeta) % numAlpha, radius, alphaIdx);
+    gridAxisIndices(numBeta, step, bestIdx % numBeta, radius, betaIdx);
+    
+    std::vector<size_t> pointIdx;
+    std::vector<Model> grid;
+    for (size_t i = 0; i < gammaIdx.size(); i++) {
+      for (size_t j = 0; j < alphaIdx.size(); j++) {
+        for (size_t k = 0; k < betaIdx.size(); k++) {
+          size_t idx = (gammaIdx[i] * numAlpha + alphaIdx[j]) * numBeta + betaIdx[k];
+          if (!evaluated[idx]) {
+            pointIdx.push_back(idx);
+            grid.push_back(Model(alpha_search[alphaIdx[j]], 
+                beta_search[betaIdx[k]], gamma_search[gammaIdx[i]]));
+          }
         }
       }
     }
+    
+    std::vector<double> gridObjectives;
+    evaluateGrid(grid, gridObjectives);
+    for (size_t i = 0; i < pointIdx.size(); i++) {
+      objective[pointIdx[i]] = gridObjectives[i];
+      evaluated[pointIdx[i]] = true;
+    }
+    
+    // the first best point in (gamma, alpha, beta) order is kept, as in an
+    // exhaustive serial search
+    double best_objective = -100000000;
+    for (size_t idx = 0; idx < numPoints; idx++) {
+      if (evaluated[idx] && objective[idx] > best_objective) {
+        best_objective = objective[idx];
+        bestIdx = idx;
+      }
+    }
+    
+    if (best_objective == -100000000) {
+      alpha_ = beta_ = gamma_ = -1.0;
+      return;
+    }
   }
-  alpha_ = alpha_best;
-  beta_ = beta_best;
-  gamma_ = gamma_best;
+  
+  gamma_ = gamma_search[bestIdx / (numAlpha * numBeta)];
+  alpha_ = alpha_search[(bestIdx / numBeta) % numAlpha];
+  beta_ = beta_search[bestIdx % numBeta];
 }
 
-double FidoInterface::calcObjective(double alpha, double beta, double gamma) {
-  std::vector<std::vector<std::string> > names;
-  std::vector<double> probs, empq, estq; 
+/*
+* The protein probabilities of a block of grid points are computed in 
+* parallel, each worker evaluating its own model on the shared, read-only 
+* graph. The objectives are then computed serially in grid order, since they
+* update the pi0 and rocN estimates.
+*/
+void FidoInterface::evaluateGrid(const std::vector<Model>& grid, 
+    std::vector<double>& objectives) {
+  objectives.clear();
+  for (size_t start = 0; start < grid.size(); start += kGridBlockSize) {
+    int blockSize = static_cast<int>(std::min(grid.size() - start, 
+                                              (size_t)kGridBlockSize));
+    std::vector<std::vector<int> > orders(blockSize);
+    std::vector<std::vector<double> > probs(blockSize);
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int i = 0; i < blockSize; i++) {
+      Array<double> probsPresentProteins;
+      proteinGraph_->proteinProbs(grid[start + i], probsPresentProteins);
+      proteinGraph_->getProteinRanking(probsPresentProteins, orders[i], probs[i]);
+    }
+    for (int i = 0; i < blockSize; i++) {
+      objectives.push_back(calcObjective(grid[start + i], orders[i], probs[i]));
+    }
+  }
+}
+
+double FidoInterface::calcObjective(const Model& model, 
+    const std::vector<int>& order,
+    const std::vector<double>& probs) {
+  std::vector<double> empq, estq; 
   double roc ,mse, objective;
   
-  proteinGraph_->setAlphaBetaGamma(alpha, beta, gamma);
-  proteinGraph_->getProteinProbs();
-  proteinGraph_->getProteinProbsAndNames(names, probs);
-  
-  getEstimated_and_Empirical_FDR(names, probs, empq, estq);
-  getROC_AUC(names, probs, roc);
+  getEstimated_and_Empirical_FDR(order, probs, empq, estq);
+  getROC_AUC(order, probs, roc);
   getFDR_MSE(estq, empq, mse);
   
   objective = (kObjectiveLambda * roc) - fabs((1-kObjectiveLambda) * mse);
   
   if (VERB > 2) {
     std::cerr.precision(10);
-    std::cerr << "Grid searching Alpha= "  << alpha << 
-                 " Beta= " << beta << 
-                 " Gamma= "  << gamma << std::endl;
+    std::cerr << "Grid searching Alpha= "  << model.alpha << 
+                 " Beta= " << model.beta << 
+                 " Gamma= "  << model.gamma << std::endl;
     std::cerr.unsetf(std::ios::floatfield);
     std::cerr << "The ROC AUC estimated values is : " << roc << std::endl;
     std::cerr << "The MSE FDR estimated values is : " << mse << std::endl;
@@ -405,7 +544,7 @@ double FidoInterface::calcObjective(double alpha, double beta, double gamma) {
   return objective;
 }
 
-void FidoInterface::getROC_AUC(const std::vector<std::vector<string> > &names,
+void FidoInterface::getROC_AUC(const std::vector<int> &order,
             const std::vector<double> &probabilities, double &auc) {
   /* Estimate ROC auc1 area as : (So - no(no + 1) / 2) / (no*n1)
    * where no = number of target
@@ -441,18 +580,11 @@ void FidoInterface::getROC_AUC(const std::vector<std::vector<string> > &names,
   double prev_prob = -1;
   auc = 0.0;
   
-  // assuming names and probabilities same size; rocN_ set by getEstimated_and_Empirical_FDR()
-  for (unsigned k = 0; k < names.size() && fp <= rocN_; k++) {
+  // assuming order and probabilities same size; rocN_ set by getEstimated_and_Empirical_FDR()
+  for (unsigned k = 0; k < order.size() && fp <= rocN_; k++) {
     double prob = probabilities[k];
-    unsigned tpChange = countTargets(names[k]);
-    unsigned fpChange = names[k].size() - tpChange;
-    //if ties activated count groups as 1 protein
-    if (trivialGrouping_) {
-      if (tpChange > 0) tpChange = 1;
-      if (fpChange > 0) fpChange = 1;
-    }
-    tp += tpChange;
-    fp += fpChange;
+    tp += groupTargets_[ order[k] ];
+    fp += groupDecoys_[ order[k] ];
     //should only do it when fp changes and either of them is != 0
     if (prev_prob != -1 && fp != 0 && tp != 0 && fp != prev_fp) {
       double trapezoid = trapezoid_area(fp,prev_fp,tp,prev_tp);
@@ -476,7 +608,7 @@ void FidoInterface::getROC_AUC(const std::vector<std::vector<string> > &names,
 
 
 void FidoInterface::getEstimated_and_Empirical_FDR(
-    const std::vector<std::vector<string> >& proteinNames,
+    const std::vector<int>& order,
     const std::vector<double>& probabilities,
     std::vector<double>& empq, 
     std::vector<double>& estq) {
@@ -488,11 +620,9 @@ void FidoInterface::getEstimated_and_Empirical_FDR(
   if (usePi0_) {
     targetDecoyRatio = static_cast<double>(numberTargetProteins_) / numberDecoyProteins_;
     std::vector<std::pair<double, bool> > combined;
-    for (unsigned int k = 0; k < proteinNames.size(); ++k) {
-      double prob = probabilities[k];
-      unsigned tpChange = countTargets(proteinNames[k]);
-      unsigned fpChange = proteinNames[k].size() - tpChange;
-      bool isDecoy = (tpChange == 0);
+    combined.reserve(order.size());
+    for (unsigned int k = 0; k < order.size(); ++k) {
+      bool isDecoy = (groupTargets_[ order[k] ] == 0);
       combined.push_back(make_pair(probabilities[k], !isDecoy));
     }
     
@@ -503,16 +633,10 @@ void FidoInterface::getEstimated_and_Empirical_FDR(
   FDRCalculator fdrCalculator(usePi0_, targetDecoyRatio, pi0_ * absenceRatio_, countDecoyQvalue_);
   
   //NOTE no need to store more q values since they will not be taken into account while estimating MSE FDR divergence
-  for (unsigned int k = 0; (k < proteinNames.size() && 
+  for (unsigned int k = 0; (k < order.size() && 
         (fdrCalculator.getPreviousEstQ() <= mseThreshold_)); k++) {
-    double prob = probabilities[k];
-    unsigned tpChange = countTargets(proteinNames[k]);
-    unsigned fpChange = proteinNames[k].size() - tpChange;
-    if (trivialGrouping_) {
-      if (tpChange > 0) tpChange = 1;
-      if (fpChange > 0) fpChange = 1;
-    }
-    fdrCalculator.calcFDRs(fpChange, tpChange, prob, empq, estq);
+    fdrCalculator.calcFDRs(groupDecoys_[ order[k] ], groupTargets_[ order[k] ], 
+                           probabilities[k], empq, estq);
   }
   if (kUpdateRocN) rocN_ = fdrCalculator.getRocN();
 }
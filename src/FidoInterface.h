@@ -62,6 +62,12 @@ class FidoInterface : public ProteinProbEstimator {
   const static bool kUpdateRocN = true;
   /** activate the optimization of the parameters to see the best boundaries**/
   const static bool kOptimizeParams = false;
+  /** with the coarse grid search, grids with more points than this are searched coarse-to-fine **/
+  const static unsigned kMaxFullGridPoints = 500u;
+  /** step between the points of the coarse grid, and radius of the refinement around its optimum **/
+  const static unsigned kCoarseGridStride = 3u;
+  /** number of grid points whose protein probabilities are computed concurrently **/
+  const static unsigned kGridBlockSize = 32u;
 
  public:
   FidoInterface(double alpha = -1, double beta = -1, double gamma = -1, 
@@ -70,7 +76,9 @@ class FidoInterface : public ProteinProbEstimator {
     unsigned gridSearchDepth = 0u, double gridSearchThreshold = 0.0, 
     double proteinThreshold = 0.01, double mse_threshold = 0.1, 
     double pi0 = 1.0, bool outputEmpirQVal = false, 
-    std::string decoyPattern = "random", bool trivialGrouping = true);
+    std::string decoyPattern = "random", bool trivialGrouping = true,
+    double approximationThreshold = 0.0, double configurationBudget = 0.0,
+    bool coarseGridSearch = false);
   virtual ~FidoInterface();
   
   bool initialize(Scores* fullset) { return ProteinProbEstimator::initialize(fullset); }
@@ -91,6 +99,12 @@ class FidoInterface : public ProteinProbEstimator {
   bool noPartitioning_, noClustering_, noPruning_;
   /* turns off pruning of edges to proteins with only low confident PSMs */
   double proteinThreshold_;
+  /* log2 number of configurations above which subgraphs are solved with
+     loopy belief propagation instead of being split; 0 turns this off */
+  double approximationThreshold_;
+  /* log2 of the total number of configurations shared between the graph
+     components; 0 allows LOG_MAX_ALLOWED_CONFIGURATIONS in each of them */
+  double configurationBudget_;
   
   /** GRID SEARCH PARAMETERS **/
   
@@ -100,18 +114,27 @@ class FidoInterface : public ProteinProbEstimator {
   bool doGridSearch_;
   /* uses strict thresholds to create a sparse graph for the grid search */ 
   double gridSearchThreshold_;
+  /* searches large grids coarse-to-fine instead of exhaustively */
+  bool coarseGridSearch_;
   /* threshold in MSE estimation */
   double mseThreshold_;
   /* threshold for ROC AUC estimation */
   mutable unsigned int rocN_;
+  /* number of target and decoy proteins of each group of the graph, in the
+     order of GroupPowerBigraph::getProteinNames; clamped to 0/1 with 
+     trivial grouping */
+  std::vector<unsigned> groupTargets_, groupDecoys_;
   
+  void labelProteinGroups();
   void updateTargetDecoySizes();
+  void rankProteinGroups(
+      const std::multimap<double, std::vector<std::string> > &pepProteinMap);
   
   /** fido extra functions to do the grid search for parameters alpha,beta and gamma **/
-  void getROC_AUC(const std::vector<std::vector<string> > &names,
+  void getROC_AUC(const std::vector<int> &order,
        const std::vector<double> &probabilities, double &auc);
   
-  void getEstimated_and_Empirical_FDR(const std::vector<std::vector<string> > &names,
+  void getEstimated_and_Empirical_FDR(const std::vector<int> &order,
           const std::vector<double> &probabilities,
           std::vector<double> &empq,
           std::vector<double> &estq);
@@ -123,7 +146,11 @@ class FidoInterface : public ProteinProbEstimator {
   void gridSearch(std::vector<double>& alpha_search, 
                   std::vector<double>& beta_search, 
                   std::vector<double>& gamma_search);
-  double calcObjective(double alpha, double beta, double gamma);  
+  void evaluateGrid(const std::vector<Model>& grid, 
+                    std::vector<double>& objectives);
+  double calcObjective(const Model& model, 
+                       const std::vector<int>& order,
+                       const std::vector<double>& probs);
   
 };
 
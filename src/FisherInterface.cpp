@@ -17,12 +17,43 @@
 
 #include "FisherInterface.h"
 
+namespace {
+  /* whether a protein is a fragment or duplicate of another one */
+  enum Redundancy {
+    NOT_REDUNDANT, FRAGMENT, DUPLICATE
+  };
+  
+  /* orders (group, protein) pairs by group, then by protein name */
+  struct GroupMemberCmp {
+    const ProteinIdIndex& proteinIds;
+    GroupMemberCmp(const ProteinIdIndex& ids) : proteinIds(ids) {}
+    bool operator()(const std::pair<int, int>& a, 
+                    const std::pair<int, int>& b) const {
+      return a.first < b.first || (a.first == b.first && 
+          proteinIds.getName(a.second) < proteinIds.getName(b.second));
+    }
+  };
+  
+  /* orders groups as IntCmpScore orders their proteins */
+  struct GroupScoreCmp {
+    const std::vector<Protein*>& proteins;
+    GroupScoreCmp(const std::vector<Protein*>& prots) : proteins(prots) {}
+    bool operator()(int a, int b) const {
+      return ( proteins[a]->getScore() < proteins[b]->getScore()
+           || (proteins[a]->getScore() == proteins[b]->getScore() 
+              && proteins[a]->getName() < proteins[b]->getName())
+      );
+    }
+  };
+}
+
 FisherInterface::FisherInterface(const std::string& fastaDatabase,
     double pvalueCutoff, bool reportFragmentProteins, bool reportDuplicateProteins,
     bool trivialGrouping, double absenceRatio, bool outputEmpirQval, 
-    std::string& decoyPattern) :
+    std::string& decoyPattern, const std::string& digestCacheDirectory) :
       ProteinProbEstimator(trivialGrouping, absenceRatio, outputEmpirQval, decoyPattern),
-      fastaProteinFN_(fastaDatabase), maxPeptidePval_(pvalueCutoff),
+      fastaProteinFN_(fastaDatabase), digestCacheDirectory_(digestCacheDirectory),
+      maxPeptidePval_(pvalueCutoff),
       reportFragmentProteins_(reportFragmentProteins),
       reportDuplicateProteins_(reportDuplicateProteins),
       protInferenceMethod_(BESTPEPT) {
@@ -134,6 +165,7 @@ void FisherInterface::run() {
   std::map<std::string, std::string> fragment_map, duplicate_map;
   if (fastaProteinFN_ != "auto") {
     fisherCaller_.setFastaDatabase(fastaProteinFN_);
+    fisherCaller_.setDigestCacheDirectory(digestCacheDirectory_);
     
     if (VERB > 1) {
       std::cerr << "Detecting protein fragments/duplicates in target database" << std::endl;
@@ -148,84 +180,141 @@ void FisherInterface::run() {
     fisherCaller_.getProteinFragmentsAndDuplicates(fragment_map, duplicate_map, generateDecoys);
   }
   
-  std::map<std::string, std::set<std::string> > groupProteinIds;
-  unsigned int numGroups = 0;
+  // first pass: intern the proteins of the PSMs below the p-value cutoff
+  std::vector<size_t> psmProteinOffsets(1, 0u);
+  std::vector<int> psmProteins;
+  for (vector<ScoreHolder>::iterator peptideIt = peptideScores_->begin(); 
+          peptideIt != peptideScores_->end(); ++peptideIt) {
+    if (peptideIt->p > maxPeptidePval_) continue;
+    std::vector<std::string>& proteinIds = peptideIt->pPSM->proteinIds;
+    if (proteinIds.empty()) {
+      psmProteins.push_back(proteinIds_.insert(""));
+    }
+    for (std::vector<std::string>::iterator protIt = proteinIds.begin(); 
+            protIt != proteinIds.end(); protIt++) {
+      psmProteins.push_back(proteinIds_.insert(*protIt));
+    }
+    psmProteinOffsets.push_back(psmProteins.size());
+  }
+  
+  // look up once which protein represents every fragment or duplicate
+  // protein; this can add proteins, which are resolved as well
+  std::vector<int> representatives;
+  std::vector<Redundancy> redundancies;
+  for (size_t k = 0; k < proteinIds_.size(); ++k) {
+    std::string proteinId = proteinIds_.getName(k);
+    std::map<std::string, std::string>::const_iterator it;
+    if ((it = fragment_map.find(proteinId)) != fragment_map.end()) {
+      redundancies.push_back(FRAGMENT);
+      representatives.push_back(proteinIds_.insert(it->second));
+    } else if ((it = duplicate_map.find(proteinId)) != duplicate_map.end()) {
+      redundancies.push_back(DUPLICATE);
+      representatives.push_back(proteinIds_.insert(it->second));
+    } else {
+      redundancies.push_back(NOT_REDUNDANT);
+      representatives.push_back(k);
+    }
+  }
+  
+  // second pass: assign the peptides to protein groups
+  std::vector<int> groupOfProtein(proteinIds_.size(), -1);
+  std::vector<std::pair<int, int> > groupMemberPairs;
+  std::vector<int> proteinsInGroup;
+  size_t psmIdx = 0;
   for (vector<ScoreHolder>::iterator peptideIt = peptideScores_->begin(); 
           peptideIt != peptideScores_->end(); ++peptideIt) {
-    std::string lastProteinId;
-    std::set<std::string> proteinsInGroup;
-    bool isFirst = true, isShared = false;
-    
     if (peptideIt->p > maxPeptidePval_) continue;
     
-    for (std::vector<std::string>::iterator protIt = peptideIt->pPSM->proteinIds.begin(); 
-            protIt != peptideIt->pPSM->proteinIds.end(); protIt++) {
-      std::string proteinId = *protIt;
-      
-      if (fragment_map.find(proteinId) != fragment_map.end()) {
-        if (reportFragmentProteins_) proteinsInGroup.insert(*protIt);
-        proteinId = fragment_map[proteinId];
-      } else if (duplicate_map.find(proteinId) != duplicate_map.end()) {
-        if (reportDuplicateProteins_) proteinsInGroup.insert(*protIt);
-        proteinId = duplicate_map[proteinId];
+    int lastProtein = -1;
+    bool isFirst = true, isShared = false;
+    proteinsInGroup.clear();
+    for (size_t k = psmProteinOffsets[psmIdx]; 
+            k < psmProteinOffsets[psmIdx + 1]; ++k) {
+      int psmProtein = psmProteins[k], protein = psmProtein;
+      if (redundancies[psmProtein] == FRAGMENT) {
+        if (reportFragmentProteins_) proteinsInGroup.push_back(psmProtein);
+        protein = representatives[psmProtein];
+      } else if (redundancies[psmProtein] == DUPLICATE) {
+        if (reportDuplicateProteins_) proteinsInGroup.push_back(psmProtein);
+        protein = representatives[psmProtein];
       } else {
-        proteinsInGroup.insert(*protIt);
+        proteinsInGroup.push_back(psmProtein);
       }
       
       if (isFirst) {
-        lastProteinId = proteinId;
+        lastProtein = protein;
         isFirst = false;
-      } else if (lastProteinId != proteinId) {
+      } else if (lastProtein != protein) {
         isShared = true;
         break;
       }
     }
+    ++psmIdx;
     
+    std::sort(proteinsInGroup.begin(), proteinsInGroup.end());
+    proteinsInGroup.erase(std::unique(proteinsInGroup.begin(), 
+        proteinsInGroup.end()), proteinsInGroup.end());
     if (proteinsInGroup.size() == 1) {
-      lastProteinId = *(proteinsInGroup.begin());
+      lastProtein = proteinsInGroup[0];
     }
     
     if (!isShared) {
       Protein::Peptide *peptide = new Protein::Peptide(
           peptideIt->pPSM->getPeptideSequence(), peptideIt->isDecoy(),
 			    peptideIt->p, peptideIt->pep, peptideIt->q, peptideIt->score);
-      if (proteins_.find(lastProteinId) == proteins_.end()) {
-        if (proteinsInGroup.size() > 1) {
-          groupProteinIds[lastProteinId] = proteinsInGroup;
-        }
-        Protein *newprotein = new Protein(lastProteinId, peptideIt->isDecoy(),
-            peptide, ++numGroups);
-        proteins_.insert(std::make_pair(lastProteinId,newprotein));
-        if (lastProteinId.find(decoyPattern_) == std::string::npos) {
+      int group = groupOfProtein[lastProtein];
+      if (group == -1) {
+        // the groups are the proteins of the estimator, so that the group 
+        // index is the protein id
+        const std::string& proteinName = proteinIds_.getName(lastProtein);
+        Protein *newprotein = new Protein(proteinName, peptideIt->isDecoy(),
+            peptide, proteins_.size() + 1);
+        group = addProtein(proteinName, newprotein);
+        groupOfProtein[lastProtein] = group;
+        groupRepresentatives_.push_back(lastProtein);
+        if (proteinName.find(decoyPattern_) == std::string::npos) {
           ++numberTargetProteins_;
         } else {
           ++numberDecoyProteins_;
         }
       } else {
-        proteins_[lastProteinId]->setPeptide(peptide);
-        if (proteinsInGroup.size() > 1) {
-          groupProteinIds[lastProteinId].insert(proteinsInGroup.begin(), 
-                                                 proteinsInGroup.end());
+        proteins_[group]->setPeptide(peptide);
+      }
+      if (proteinsInGroup.size() > 1) {
+        for (size_t k = 0; k < proteinsInGroup.size(); ++k) {
+          groupMemberPairs.push_back(std::make_pair(group, proteinsInGroup[k]));
         }
       }
     }
   }
   
+  // store the members of every group sorted by name, without repeats
+  std::sort(groupMemberPairs.begin(), groupMemberPairs.end(), 
+            GroupMemberCmp(proteinIds_));
+  groupMemberPairs.erase(std::unique(groupMemberPairs.begin(), 
+      groupMemberPairs.end()), groupMemberPairs.end());
+  groupMemberOffsets_.assign(proteins_.size() + 1, 0u);
+  groupMembers_.resize(groupMemberPairs.size());
+  for (size_t k = 0; k < groupMemberPairs.size(); ++k) {
+    ++groupMemberOffsets_[groupMemberPairs[k].first + 1];
+    groupMembers_[k] = groupMemberPairs[k].second;
+  }
+  for (size_t group = 0; group < proteins_.size(); ++group) {
+    groupMemberOffsets_[group + 1] += groupMemberOffsets_[group];
+  }
+  
   if (reportFragmentProteins_ || reportDuplicateProteins_) {
-    std::map<std::string, std::set<std::string> >::iterator groupIt;
-    std::map<const std::string,Protein*>::iterator representIt;
-    for (groupIt = groupProteinIds.begin(); groupIt != groupProteinIds.end(); ++groupIt) {
-      representIt = proteins_.find(groupIt->first);
-      if (representIt != proteins_.end()) {
-        std::string newName = "";
-        for (std::set<std::string>::iterator proteinIt = groupIt->second.begin(); proteinIt != groupIt->second.end(); ++proteinIt) {
-          std::string proteinId = *proteinIt;
-          std::replace(proteinId.begin(), proteinId.end(), ',', ';');
-          newName += proteinId + ",";
-        }
-        newName = newName.substr(0, newName.size() - 1);
-        representIt->second->setName(newName);
+    for (size_t group = 0; group < proteins_.size(); ++group) {
+      if (groupMemberOffsets_[group] == groupMemberOffsets_[group + 1]) continue;
+      std::string newName = "";
+      for (size_t k = groupMemberOffsets_[group]; 
+              k < groupMemberOffsets_[group + 1]; ++k) {
+        std::string proteinId = proteinIds_.getName(groupMembers_[k]);
+        std::replace(proteinId.begin(), proteinId.end(), ',', ';');
+        newName += proteinId + ",";
       }
+      newName = newName.substr(0, newName.size() - 1);
+      proteins_[group]->setName(newName);
     }
   }
 }
@@ -235,9 +324,9 @@ void FisherInterface::computeProbabilities(const std::string& fname) {
     std::cerr << "Computing protein probabilities for " 
               << proteins_.size() << " protein groups." << std::endl;
   }
-  for (std::map<const std::string,Protein*>::iterator it = proteins_.begin(); 
+  for (std::vector<Protein*>::iterator it = proteins_.begin(); 
         it != proteins_.end(); it++) {
-    std::vector<Protein::Peptide*> peptides = it->second->getPeptides();
+    std::vector<Protein::Peptide*> peptides = (*it)->getPeptides();
     switch (protInferenceMethod_) {
       case FISHER: {
         double fisher = 0.0;
@@ -249,8 +338,8 @@ void FisherInterface::computeProbabilities(const std::string& fname) {
         //double proteinPvalue = boost::math::gamma_q(peptides.size(), -1.0*fisher);
         double proteinPvalue = 0.0;
         if (proteinPvalue == 0.0) proteinPvalue = DBL_MIN;
-        it->second->setP(proteinPvalue);
-        it->second->setScore(proteinPvalue);
+        (*it)->setP(proteinPvalue);
+        (*it)->setScore(proteinPvalue);
         break;
       } case PEPPROD: { // MaxQuant's strategy
         double logPepProd = 0.0;
@@ -258,7 +347,7 @@ void FisherInterface::computeProbabilities(const std::string& fname) {
               itP != peptides.end(); itP++) {
           logPepProd += log((*itP)->pep);
         }
-        it->second->setScore(logPepProd);
+        (*it)->setScore(logPepProd);
         break;
       } case BESTPEPT: {
         double maxScore = -1000.0;
@@ -266,92 +355,111 @@ void FisherInterface::computeProbabilities(const std::string& fname) {
               itP != peptides.end(); itP++) {
           maxScore = std::max(maxScore, (*itP)->score);
         }
-        it->second->setScore(-1.0*maxScore); // lower scores are better
+        (*it)->setScore(-1.0*maxScore); // lower scores are better
         break;
       }
     }
   }
   
-  std::vector<std::pair<std::string,Protein*> > protIdProtPairs(proteins_.begin(), proteins_.end());
-  std::sort(protIdProtPairs.begin(), protIdProtPairs.end(), IntCmpScore());
+  std::vector<int> groupOrder(proteins_.size());
+  for (size_t group = 0; group < groupOrder.size(); ++group) {
+    groupOrder[group] = group;
+  }
+  std::sort(groupOrder.begin(), groupOrder.end(), 
+            GroupScoreCmp(proteins_));
   
   if (!usePi0_) {
-    pickedProteinStrategy(protIdProtPairs);
+    pickedProteinStrategy(groupOrder);
   }
   
   std::vector<double> peps;
-  estimatePEPs(protIdProtPairs, peps);
+  estimatePEPs(groupOrder, peps);
   
-  for (size_t i = 0; i < protIdProtPairs.size(); ++i) {
-    pepProteinMap_.insert(std::make_pair(peps[i], std::vector<std::string>(1, protIdProtPairs[i].first) ));
+  clearRankedGroups();
+  for (size_t i = 0; i < groupOrder.size(); ++i) {
+    addRankedGroup(peps[i], std::vector<int>(1, groupOrder[i]));
   }
 }
 
-bool FisherInterface::pickedProteinCheckId(std::string& proteinId, bool isDecoy,
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts) {
+bool FisherInterface::pickedProteinCheckId(int proteinId, bool isDecoy,
+    const std::vector<int>& targetPartners, 
+    const std::vector<int>& decoyPartners,
+    std::vector<bool>& targetProts, std::vector<bool>& decoyProts,
+    size_t& numTargetProts, size_t& numDecoyProts) {
   bool found = false;
   if (isDecoy) {
-    std::string targetId = proteinId.substr(decoyPattern_.size());
-    if (targetProts.find(targetId) != targetProts.end()) {
+    int targetId = targetPartners[proteinId];
+    if (targetId != ProteinIdIndex::kNotFound && targetProts[targetId]) {
       found = true;
-    } else {
-      decoyProts.insert(proteinId);
+    } else if (!decoyProts[proteinId]) {
+      decoyProts[proteinId] = true;
+      ++numDecoyProts;
     }
   } else {
-    if (decoyProts.find(decoyPattern_ + proteinId) != decoyProts.end()) {
+    int decoyId = decoyPartners[proteinId];
+    if (decoyId != ProteinIdIndex::kNotFound && decoyProts[decoyId]) {
       found = true;
-    } else {
-      targetProts.insert(proteinId);
+    } else if (!targetProts[proteinId]) {
+      targetProts[proteinId] = true;
+      ++numTargetProts;
     }
   }
   return found;
 }
 
-bool FisherInterface::pickedProteinCheck(std::string& proteinName, bool isDecoy, 
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts) {
-  bool erase = false;
-  if (reportFragmentProteins_ || reportDuplicateProteins_) {
-    std::istringstream ss(proteinName); 
-    std::string proteinId;
-    while (std::getline(ss, proteinId, ',')) { // split name by comma
-      erase = erase || pickedProteinCheckId(proteinId, isDecoy, 
-                                          targetProts, decoyProts);
-    }
-  } else {
-    erase = pickedProteinCheckId(proteinName, isDecoy, targetProts, decoyProts);
-  }
-  return erase;
-}
-
 /* Executes the picked protein-FDR strategy from Savitski et al. 2015
    For protein groups, if one of the corresponding proteins has been observed
    the whole group is eliminated */
-void FisherInterface::pickedProteinStrategy(
-    std::vector<std::pair<std::string,Protein*> >& protIdProtPairs) {
+void FisherInterface::pickedProteinStrategy(std::vector<int>& groupOrder) {
   if (VERB > 1) {
     std::cerr << "Performing picked protein strategy" << std::endl;
   }
   
-  std::vector<std::pair<std::string,Protein*> > pickedProtIdProtPairs;
-  std::set<std::string> targetProts, decoyProts;
-  std::vector<std::pair<std::string,Protein*> >::iterator it = protIdProtPairs.begin();
+  // the target and decoy counterpart of every protein, by the decoy pattern
+  size_t numProteins = proteinIds_.size();
+  std::vector<int> targetPartners(numProteins), decoyPartners(numProteins);
+  for (size_t k = 0; k < numProteins; ++k) {
+    const std::string& proteinId = proteinIds_.getName(k);
+    decoyPartners[k] = proteinIds_.find(decoyPattern_ + proteinId);
+    targetPartners[k] = proteinId.size() < decoyPattern_.size() ? 
+        ProteinIdIndex::kNotFound : 
+        proteinIds_.find(proteinId.substr(decoyPattern_.size()));
+  }
+  
+  std::vector<int> pickedGroupOrder;
+  std::vector<bool> targetProts(numProteins, false), decoyProts(numProteins, false);
+  size_t numTargetProts = 0, numDecoyProts = 0;
+  std::vector<int>::iterator it = groupOrder.begin();
   size_t numErased = 0;
   // TODO: what about peptides with both target and decoy proteins?
-  for (; it != protIdProtPairs.end(); ++it) {
-    bool isDecoy = it->second->getIsDecoy();
-    std::string proteinName = it->second->getName(); 
+  for (; it != groupOrder.end(); ++it) {
+    int group = *it;
+    bool isDecoy = proteins_[group]->getIsDecoy();
     
-    bool erase = pickedProteinCheck(proteinName, isDecoy, targetProts, decoyProts);
+    bool erase = false;
+    if ((reportFragmentProteins_ || reportDuplicateProteins_) && 
+        groupMemberOffsets_[group] != groupMemberOffsets_[group + 1]) {
+      for (size_t k = groupMemberOffsets_[group]; 
+              k < groupMemberOffsets_[group + 1] && !erase; ++k) {
+        erase = pickedProteinCheckId(groupMembers_[k], isDecoy, targetPartners,
+            decoyPartners, targetProts, decoyProts, numTargetProts, numDecoyProts);
+      }
+    } else {
+      erase = pickedProteinCheckId(groupRepresentatives_[group], isDecoy, 
+          targetPartners, decoyPartners, targetProts, decoyProts, 
+          numTargetProts, numDecoyProts);
+    }
     if (erase) {
       if (isDecoy) --numberDecoyProteins_;
       else --numberTargetProteins_;
-      proteins_.erase(it->first); // this is where the printed proteins are stored
+      // the group is no longer printed
+      removeProtein(group);
       numErased += 1;
     } else {
-      pickedProtIdProtPairs.push_back(*it);
+      pickedGroupOrder.push_back(group);
     }
   }
-  pickedProtIdProtPairs.swap(protIdProtPairs);
+  pickedGroupOrder.swap(groupOrder);
   
   if (numErased == 0) {
     std::cerr << "Warning: No target-decoy protein pairs found for the picked "
@@ -363,21 +471,20 @@ void FisherInterface::pickedProteinStrategy(
   
   if (VERB > 1) {
     std::cerr << "Eliminated lower-scoring target-decoy protein: "
-              << targetProts.size() << " target proteins and "
-              << decoyProts.size() << " decoy proteins remaining." << std::endl;
+              << numTargetProts << " target proteins and "
+              << numDecoyProts << " decoy proteins remaining." << std::endl;
   }
 }
 
-void FisherInterface::estimatePEPs(
-    std::vector<std::pair<std::string,Protein*> >& protIdProtPairs,
+void FisherInterface::estimatePEPs(const std::vector<int>& groupOrder,
     std::vector<double>& peps) {
   std::vector<std::pair<double, bool> > combined;
   std::vector<double> pvals;
   switch (protInferenceMethod_) {
     case FISHER: { // if we have well calibrated p-values
-      for (size_t i = 0; i < protIdProtPairs.size(); ++i) {
-        double pValue = protIdProtPairs[i].second->getP();
-        bool isDecoy = protIdProtPairs[i].second->getIsDecoy();
+      for (size_t i = 0; i < groupOrder.size(); ++i) {
+        double pValue = proteins_[groupOrder[i]]->getP();
+        bool isDecoy = proteins_[groupOrder[i]]->getIsDecoy();
         combined.push_back(make_pair(pValue, !isDecoy));
         if (!isDecoy) {
           pvals.push_back(pValue);
@@ -388,9 +495,9 @@ void FisherInterface::estimatePEPs(
       break;
     } case PEPPROD:
       case BESTPEPT: { // if we have some other type of score
-      for (size_t i = 0; i < protIdProtPairs.size(); ++i) {
-        double score = protIdProtPairs[i].second->getScore();
-        bool isDecoy = protIdProtPairs[i].second->getIsDecoy();
+      for (size_t i = 0; i < groupOrder.size(); ++i) {
+        double score = proteins_[groupOrder[i]]->getScore();
+        bool isDecoy = proteins_[groupOrder[i]]->getIsDecoy();
         combined.push_back(make_pair(score, !isDecoy));
       }
       std::sort(combined.begin(), combined.end());
@@ -24,6 +24,7 @@
 //#include <boost/math/special_functions/gamma.hpp>
 
 #include "ProteinProbEstimator.h"
+#include "ProteinIdIndex.h"
 #include "PosteriorEstimator.h"
 #include "FisherCaller.h"
 #include "Enzyme.h"
@@ -55,7 +56,8 @@ class FisherInterface : public ProteinProbEstimator {
   FisherInterface(const std::string& fastaDatabase, double pvalueCutoff,
     bool reportFragmentProteins, bool reportDuplicateProteins, 
     bool trivialGrouping, double absenceRatio, 
-    bool outputEmpirQval, std::string& decoyPattern);
+    bool outputEmpirQval, std::string& decoyPattern, 
+    const std::string& digestCacheDirectory = "");
   virtual ~FisherInterface();
   
   bool initialize(Scores* fullset);
@@ -66,23 +68,34 @@ class FisherInterface : public ProteinProbEstimator {
   string printCopyright();
 
  private:
-  void pickedProteinStrategy(
-    std::vector<std::pair<std::string,Protein*> >& protIdProtPairs);
-  bool pickedProteinCheckId(std::string& proteinId, bool isDecoy,
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts);
-  bool pickedProteinCheck(std::string& proteinName, bool isDecoy, 
-    std::set<std::string>& targetProts, std::set<std::string>& decoyProts);
-  void estimatePEPs(
-    std::vector<std::pair<std::string,Protein*> >& protIdProtPairs,
+  void pickedProteinStrategy(std::vector<int>& groupOrder);
+  bool pickedProteinCheckId(int proteinId, bool isDecoy,
+    const std::vector<int>& targetPartners, 
+    const std::vector<int>& decoyPartners,
+    std::vector<bool>& targetProts, std::vector<bool>& decoyProts,
+    size_t& numTargetProts, size_t& numDecoyProts);
+  void estimatePEPs(const std::vector<int>& groupOrder,
     std::vector<double>& peps);
   
   /** FISHER PARAMETERS **/
   ProteinInferenceMethod protInferenceMethod_;
   std::string fastaProteinFN_;
+  /* directory for the digest cache of the fasta file; empty turns it off */
+  std::string digestCacheDirectory_;
   bool reportFragmentProteins_, reportDuplicateProteins_;
   FisherCaller fisherCaller_;
   double maxPeptidePval_;
   
+  /* every protein id of the PSMs is interned once; the protein groups are
+     numbered in the order they are created by run(), which is also the 
+     protein id of their Protein in the estimator */
+  ProteinIdIndex proteinIds_;
+  std::vector<int> groupRepresentatives_;
+  /* protein ids of the members of each group, sorted by name, in CSR form;
+     groups without members are represented by their representative only */
+  std::vector<size_t> groupMemberOffsets_;
+  std::vector<int> groupMembers_;
+  
 };
 
 #endif // FISHERINTERFACE_H
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+#ifndef INTERNTABLE_H_
+#define INTERNTABLE_H_
+
+#ifndef WIN32
+  #include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <vector>
+
+static const uint64_t kFnv1aOffsetBasis = 14695981039346656037ULL;
+static const uint64_t kFnv1aPrime = 1099511628211ULL;
+
+/* adds a byte to a 64-bit FNV-1a hash */
+inline uint64_t fnv1aByte(uint64_t hash, unsigned char byte) {
+  return (hash ^ byte) * kFnv1aPrime;
+}
+
+/* 64-bit FNV-1a hash of the bytes, continued from hash */
+inline uint64_t fnv1a(const char* data, size_t length,
+                      uint64_t hash = kFnv1aOffsetBasis) {
+  for (size_t i = 0; i < length; ++i) {
+    hash = fnv1aByte(hash, static_cast<unsigned char>(data[i]));
+  }
+  return hash;
+}
+
+/*
+ * InternTable maps keys to the dense ids their owner gives them, through an
+ * open addressing table of their 64-bit hashes with linear probing. The keys
+ * themselves stay with the owner: a hash match is verified by a functor
+ * sameKey, for which sameKey(id) is true if the key of id is the one looked
+ * for. The load factor is kept at most 1/2, so the table is never full.
+ */
+class InternTable {
+ public:
+  static const unsigned int kNoId = ~0u;
+
+  /* the table holds up to numIds ids before it first grows */
+  explicit InternTable(size_t numIds = 32u) : numIds_(0u) {
+    size_t capacity = 16u;
+    while (capacity < 2u * numIds) capacity <<= 1;
+    Slot empty;
+    empty.hash = 0u;
+    empty.id = kNoId;
+    slots_.assign(capacity, empty);
+  }
+
+  /* returns the id of the key, or kNoId */
+  template <typename SameKey>
+  unsigned int find(uint64_t hash, const SameKey& sameKey) const {
+    return slots_[findSlot(hash, sameKey)].id;
+  }
+
+  /* returns the id of the key, adding it with newId if it is not there */
+  template <typename SameKey>
+  unsigned int intern(uint64_t hash, const SameKey& sameKey,
+                      unsigned int newId) {
+    if (2u * (numIds_ + 1u) > slots_.size()) grow();
+    Slot& slot = slots_[findSlot(hash, sameKey)];
+    if (slot.id == kNoId) {
+      slot.hash = hash;
+      slot.id = newId;
+      ++numIds_;
+    }
+    return slot.id;
+  }
+
+ private:
+  struct Slot {
+    uint64_t hash;
+    unsigned int id;
+  };
+
+  std::vector<Slot> slots_;
+  size_t numIds_;
+
+  /* returns the slot holding the key, or the empty slot where it would be
+     inserted */
+  template <typename SameKey>
+  size_t findSlot(uint64_t hash, const SameKey& sameKey) const {
+    size_t mask = slots_.size() - 1u;
+    size_t i = static_cast<size_t>(hash) & mask;
+    while (slots_[i].id != kNoId &&
+           (slots_[i].hash != hash || !sameKey(slots_[i].id))) {
+      i = (i + 1u) & mask;
+    }
+    return i;
+  }
+
+  void grow() {
+    Slot empty;
+    empty.hash = 0u;
+    empty.id = kNoId;
+    std::vector<Slot> old(slots_.size() * 2u, empty);
+    old.swap(slots_);
+
+    size_t mask = slots_.size() - 1u;
+    for (size_t k = 0; k < old.size(); ++k) {
+      if (old[k].id == kNoId) continue;
+      size_t i = static_cast<size_t>(old[k].hash) & mask;
+      while (slots_[i].id != kNoId) i = (i + 1u) & mask;
+      slots_[i] = old[k];
+    }
+  }
+};
+
+#endif /* INTERNTABLE_H_ */
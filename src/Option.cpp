@@ -107,9 +107,10 @@ void CommandLineParser::defineOption(string shortOpt, string longOpt,
 	  throw MyException(temp.str());
 	}
       }
+  // options without a short form are known by their long form
   opts.insert(opts.begin(), Option("-" + shortOpt,
                                    "--" + longOpt,
-                                   shortOpt,
+                                   shortOpt.empty() ? longOpt : shortOpt,
                                    help,
                                    helpType,
                                    typ,
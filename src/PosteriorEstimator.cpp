@@ -73,19 +73,6 @@ template<class T> void bootstrap_old(const vector<T>& in, vector<T>& out) {
   sort(out.begin(), out.end());
 }
 
-template<class T> void bootstrap(const vector<T>& in, vector<T>& out,
-                                 size_t max_size = 1000) {
-  out.clear();
-  double n = in.size();
-  size_t num_draw = min(in.size(), max_size);
-  for (size_t ix = 0; ix < num_draw; ++ix) {
-    size_t draw = (size_t)((double)PseudoRandom::lcg_rand() / ((double)PseudoRandom::kRandMax + (double)1) * n);
-    out.push_back(in[draw]);
-  }
-  // sort in desending order
-  sort(out.begin(), out.end());
-}
-
 double mymin(double a, double b) {
   return a > b ? b : a;
 }
@@ -443,6 +430,64 @@ bool PosteriorEstimator::checkSeparation(std::vector<double>& p) {
   return (Wl == 0u);
 }
 
+/**
+ * Accumulates, for each lambda, the squared deviation of bootstrapped pi0
+ * estimates from minPi0. Instead of resampling and sorting p for every
+ * replicate, the sorted p-values are binned once over the lambda grid and
+ * each replicate counts its draws per bin of that histogram. Replicates run
+ * in parallel, replicate b on the global random stream jumped ahead by
+ * b * numDraw draws, so they use the same disjoint draws as a serial loop
+ * would, and are summed in replicate order so the result is independent of
+ * the number of threads.
+ */
+void PosteriorEstimator::getPi0BootstrapMSE(const vector<double>& p,
+    const vector<double>& lambdas, double minPi0, const unsigned int numBoot,
+    vector<double>& mse, size_t maxDraw) {
+  size_t n = p.size(), numLambdas = lambdas.size();
+  mse.assign(numLambdas, 0.0);
+  if (n == 0 || numLambdas == 0) return;
+  // binEnds[ix] is the number of p-values below lambdas[ix], i.e. a draw of
+  // index k falls in bin upper_bound(binEnds, k) and has p >= lambdas[ix]
+  // iff it lands in a bin above ix. N.B. Assumes p is sorted ascending.
+  vector<size_t> binEnds(numLambdas + 1, n);
+  for (unsigned int ix = 0; ix < numLambdas; ++ix) {
+    binEnds[ix] = distance(p.begin(),
+                           lower_bound(p.begin(), p.end(), lambdas[ix]));
+  }
+  size_t numDraw = min(n, maxDraw);
+  vector<unsigned long> seeds(numBoot);
+  unsigned long seed = PseudoRandom::getSeed();
+  for (unsigned int boot = 0; boot < numBoot; ++boot) {
+    seeds[boot] = seed;
+    seed = PseudoRandom::lcg_skip(seed, numDraw);
+  }
+  // leave the global generator where the serial draws would have left it
+  PseudoRandom::setSeed(seed);
+  vector<double> sqErr(static_cast<size_t>(numBoot) * numLambdas);
+  #pragma omp parallel for schedule(static)
+  for (int boot = 0; boot < static_cast<int>(numBoot); ++boot) {
+    unsigned long seed = seeds[boot];
+    vector<unsigned int> binCounts(numLambdas + 1, 0u);
+    for (size_t d = 0; d < numDraw; ++d) {
+      size_t draw = (size_t)((double)PseudoRandom::lcg_rand(seed) / ((double)PseudoRandom::kRandMax + (double)1) * n);
+      ++binCounts[distance(binEnds.begin(),
+          upper_bound(binEnds.begin(), binEnds.end(), draw))];
+    }
+    double* bootErr = &sqErr[static_cast<size_t>(boot) * numLambdas];
+    size_t Wl = 0;
+    for (size_t ix = numLambdas; ix-- > 0; ) {
+      Wl += binCounts[ix + 1];
+      double pi0Boot = (double)Wl / numDraw / (1 - lambdas[ix]);
+      bootErr[ix] = (pi0Boot - minPi0) * (pi0Boot - minPi0);
+    }
+  }
+  for (unsigned int boot = 0; boot < numBoot; ++boot) {
+    for (unsigned int ix = 0; ix < numLambdas; ++ix) {
+      mse[ix] += sqErr[static_cast<size_t>(boot) * numLambdas + ix];
+    }
+  }
+}
+
 /*
  * Described in Storey, "A direct approach to false discovery rates."
  * JRSS 2002.
@@ -474,22 +519,9 @@ double PosteriorEstimator::estimatePi0(vector<double>& p,
   }
   double minPi0 = *min_element(pi0s.begin(), pi0s.end());
   
-  vector<double> pBoot, mse;
-  // Initialize the vector mse with zeroes.
-  fill_n(back_inserter(mse), pi0s.size(), 0.0);
+  vector<double> mse;
   // Examine which lambda level that is most stable under bootstrap
-  for (unsigned int boot = 0; boot < numBoot; ++boot) {
-    // Create an array of bootstrapped p-values, and sort in ascending order.
-    bootstrap<double> (p, pBoot);
-    n = pBoot.size();
-    for (unsigned int ix = 0; ix < lambdas.size(); ++ix) {
-      start = lower_bound(pBoot.begin(), pBoot.end(), lambdas[ix]);
-      double Wl = (double)distance(start, pBoot.end());
-      double pi0Boot = Wl / n / (1 - lambdas[ix]);
-      // Estimated mean-squared error.
-      mse[ix] += (pi0Boot - minPi0) * (pi0Boot - minPi0);
-    }
-  }
+  getPi0BootstrapMSE(p, lambdas, minPi0, numBoot, mse);
   // Which index did the iterator get?
   unsigned int minIx = distance(mse.begin(), 
                                 min_element(mse.begin(), mse.end()));
@@ -54,6 +54,11 @@ class PosteriorEstimator {
     static bool checkSeparation(vector<double>& p);
     static double estimatePi0(vector<double>& p,
                               const unsigned int numBoot = 100);
+    static void getPi0BootstrapMSE(const vector<double>& p,
+                                   const vector<double>& lambdas,
+                                   double minPi0, const unsigned int numBoot,
+                                   vector<double>& mse,
+                                   size_t maxDraw = 1000);
     static void setReversed(bool status) {
 		reversed = status;
     }
@@ -73,8 +73,7 @@ class Protein {
   void setPeptides(std::vector<Peptide*> peptides) {
      peptides_ = std::vector<Peptide*>(peptides);
   }
-  std::vector<Peptide*> getPeptides() { return peptides_; }
-  std::vector<Peptide*> getPeptides() const { return peptides_; }
+  const std::vector<Peptide*>& getPeptides() const { return peptides_; }
   
   /*
   inline bool operator<(const Protein& a,const Protein& b)  {
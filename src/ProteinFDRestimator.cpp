@@ -85,16 +85,27 @@ double log_factorial(double n)
     return stirling_log_factorial(n);
 }
 
-double log_binomial(double n,double k)
+/** log_factorial, looked up in a table of precomputed values when n is in it **/
+double cached_log_factorial(double n,const std::vector<double> &logFactorials)
 {
-  return (log_factorial(n) - log_factorial(k) - log_factorial(n-k));
+  if(n >= 0 && n < logFactorials.size())
+    return logFactorials[static_cast<size_t>(n)];
+  else
+    return log_factorial(n);
 }
 
+double log_binomial(double n,double k,const std::vector<double> &logFactorials)
+{
+  return (cached_log_factorial(n,logFactorials) - cached_log_factorial(k,logFactorials) 
+	  - cached_log_factorial(n-k,logFactorials));
+}
 
-double hypergeometric(int x,int N,int w,int d)
+
+double hypergeometric(int x,int N,int w,int d,const std::vector<double> &logFactorials)
 {
   //natural logarithm of the probability
-  if(d > 0)return exp(log_binomial(w,x) + log_binomial(N-w,d-x) - log_binomial(N,d));
+  if(d > 0)return exp(log_binomial(w,x,logFactorials) + log_binomial(N-w,d-x,logFactorials) 
+		      - log_binomial(N,d,logFactorials));
   else return 0.0;
 }
 
@@ -113,6 +124,7 @@ ProteinFDRestimator::~ProteinFDRestimator()
   FreeAll(binnedProteins);
   FreeAll(groupedProteins);
   FreeAll(lengths);
+  FreeAll(logFactorials);
 }
 
 
@@ -205,21 +217,36 @@ double ProteinFDRestimator::estimateFDR(const std::set<std::string> &__target, c
       << " decoys proteins that contains high confident PSMs\n" << std::endl;    
     }
 
+    unsigned maxN = 0;
+    for(unsigned i = 0; i < nbins; i++)
+    {
+      maxN = std::max(maxN,getBinProteins(i));
+    }
+    computeLogFactorials(maxN);
+    
+    //the bins are independent, so they are estimated in parallel and summed in order
+    std::vector<unsigned> numberTP(nbins), numberFP(nbins);
+    std::vector<double> fp(nbins);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < (int)nbins; i++)
+    {
+      numberTP[i] = countProteins(i,__target);
+      numberFP[i] = countProteins(i,__decoy);
+      fp[i] = estimatePi0HG(getBinProteins(i),numberTP[i],
+			    static_cast<unsigned int>(targetDecoyRatio*numberFP[i]));
+    }
+    
     double fptol = 0.0;
     for(unsigned i = 0; i < nbins; i++)
     {
-      unsigned numberTP = countProteins(i,__target);
-      unsigned numberFP = countProteins(i,__decoy);
-      unsigned N = getBinProteins(i);
-      double fp = estimatePi0HG(N,numberTP,static_cast<unsigned int>(targetDecoyRatio*numberFP));
-      
       if(VERB > 2)
       {
-	  std::cerr << "\nEstimating FDR for bin " << i << " with " << numberFP << " Decoy proteins, "
-         << numberTP << " Target proteins, and " << N << " Total Proteins in the bin " << " with exp fp " << fp << std::endl;
+	  std::cerr << "\nEstimating FDR for bin " << i << " with " << numberFP[i] << " Decoy proteins, "
+         << numberTP[i] << " Target proteins, and " << getBinProteins(i) << " Total Proteins in the bin " 
+         << " with exp fp " << fp[i] << std::endl;
       }
 
-      fptol += fp;
+      fptol += fp[i];
     }
   
     time_t procStart;
@@ -325,7 +352,20 @@ void ProteinFDRestimator::binProteinsEqualWidth()
   return;
 }
 
-double ProteinFDRestimator::estimatePi0HG(unsigned N,unsigned targets,unsigned cf)
+void ProteinFDRestimator::computeLogFactorials(unsigned maxN)
+{
+  //same values as log_factorial, the exact ones summed in the same order
+  logFactorials.resize(maxN + 1);
+  double log_fact = 0;
+  for(unsigned n = 0; n <= maxN; n++)
+  {
+    if(n >= 2)
+      log_fact += log(static_cast<double>(n));
+    logFactorials[n] = (n < 1000) ? log_fact : stirling_log_factorial(n);
+  }
+}
+
+double ProteinFDRestimator::estimatePi0HG(unsigned N,unsigned targets,unsigned cf) const
 {
   std::vector<double> logprob;
   double finalprob = 0;
@@ -333,7 +373,7 @@ double ProteinFDRestimator::estimatePi0HG(unsigned N,unsigned targets,unsigned c
   {
     unsigned tp = targets - fp;
     unsigned w = N - tp;
-    double prob = hypergeometric(fp,N,w,cf);
+    double prob = hypergeometric(fp,N,w,cf,logFactorials);
     logprob.push_back(prob);
   }
   //normalization
@@ -350,26 +390,26 @@ double ProteinFDRestimator::estimatePi0HG(unsigned N,unsigned targets,unsigned c
 
 }
 
-unsigned int ProteinFDRestimator::countProteins(unsigned int bin,const std::set<std::string> &proteins)
+unsigned int ProteinFDRestimator::countProteins(unsigned int bin,const std::set<std::string> &proteins) const
 {
-  std::set<std::string> proteinsBins = binnedProteins[bin];
+  std::map<unsigned,std::set<std::string> >::const_iterator itbin = binnedProteins.find(bin);
+  if(itbin == binnedProteins.end())
+    return 0;
+  const std::set<std::string> &proteinsBins = itbin->second;
   unsigned count = 0;
   for(std::set<std::string>::const_iterator it = proteins.begin(); it != proteins.end(); it++)
   {
-    std::set<std::string>::iterator itfound = proteinsBins.find(*it);
-    if(itfound != proteinsBins.end())
-    {
+    if(proteinsBins.find(*it) != proteinsBins.end())
       count++;
-      proteinsBins.erase(itfound);
-    }
   }
   return count;
 }
 
 
-unsigned int ProteinFDRestimator::getBinProteins(unsigned int bin)
+unsigned int ProteinFDRestimator::getBinProteins(unsigned int bin) const
 {
-  return binnedProteins[bin].size();
+  std::map<unsigned,std::set<std::string> >::const_iterator itbin = binnedProteins.find(bin);
+  return (itbin == binnedProteins.end()) ? 0 : itbin->second.size();
 }
 
 
@@ -75,10 +75,10 @@ public:
   virtual ~ProteinFDRestimator();
 
   /** return the number of proteins in bin i **/
-  unsigned getBinProteins(unsigned bin);
+  unsigned getBinProteins(unsigned bin) const;
   
   /** return the number of proteins in bin i that are in the list of proteins given **/
-  unsigned countProteins(unsigned bin,const std::set<std::string> &proteins);
+  unsigned countProteins(unsigned bin,const std::set<std::string> &proteins) const;
   
   /** estimate and return the global FDR for a given set of target and decoy proteins **/
   double estimateFDR(const std::set<std::string> &target, const std::set<std::string> &decoy);
@@ -114,7 +114,10 @@ private:
   void groupProteinsGene();
   
   /** estimate the expected value of the hypergeometric distributions for N,TP and FP **/
-  double estimatePi0HG(unsigned N,unsigned TP,unsigned FP);
+  double estimatePi0HG(unsigned N,unsigned TP,unsigned FP) const;
+  
+  /** precomputes the log-factorials of 0..maxN used by estimatePi0HG **/
+  void computeLogFactorials(unsigned maxN);
   
   /** variables **/
   std::string decoy_prefix;
@@ -128,6 +131,7 @@ private:
   std::map<unsigned,std::set<std::string> > binnedProteins;
   std::multimap<double,std::string> groupedProteins;
   std::vector<double> lengths; 
+  std::vector<double> logFactorials;
 
 };
 #endif /* PROTEINFDRESTIMATOR_H_ */
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include "ProteinIdIndex.h"
+
+namespace {
+  /* checks an id of the index against a protein identifier */
+  struct SameName {
+    const std::vector<std::string>& names;
+    const std::string& name;
+    SameName(const std::vector<std::string>& n, const std::string& s) :
+        names(n), name(s) {}
+    bool operator()(unsigned int id) const { return names[id] == name; }
+  };
+  
+  uint64_t hashName(const std::string& proteinId) {
+    return fnv1a(proteinId.data(), proteinId.size());
+  }
+}
+
+int ProteinIdIndex::insert(const std::string& proteinId) {
+  unsigned int newId = static_cast<unsigned int>(names_.size());
+  unsigned int id = table_.intern(hashName(proteinId), 
+                                  SameName(names_, proteinId), newId);
+  if (id == newId) names_.push_back(proteinId);
+  return static_cast<int>(id);
+}
+
+int ProteinIdIndex::find(const std::string& proteinId) const {
+  unsigned int id = table_.find(hashName(proteinId), 
+                                SameName(names_, proteinId));
+  return id == InternTable::kNoId ? kNotFound : static_cast<int>(id);
+}
@@ -0,0 +1,48 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+#ifndef PROTEINIDINDEX_H_
+#define PROTEINIDINDEX_H_
+
+#include <string>
+#include <vector>
+
+#include "InternTable.h"
+
+/*
+ * ProteinIdIndex gives every distinct protein identifier a dense integer id,
+ * in the order they are first inserted, so that protein bookkeeping can use
+ * flat arrays instead of maps keyed on strings. The identifiers are found
+ * through an InternTable of their FNV-1a hashes.
+ */
+class ProteinIdIndex {
+ public:
+  static const int kNotFound = -1;
+
+  /* returns the id of the protein, adding it if it is new */
+  int insert(const std::string& proteinId);
+  /* returns the id of the protein, or kNotFound */
+  int find(const std::string& proteinId) const;
+
+  const std::string& getName(int id) const { return names_[id]; }
+  size_t size() const { return names_.size(); }
+
+ private:
+  InternTable table_;
+  std::vector<std::string> names_;
+};
+
+#endif /* PROTEINIDINDEX_H_ */
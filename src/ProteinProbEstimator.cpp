@@ -17,30 +17,35 @@
 
 #include "ProteinProbEstimator.h"
 
+#include <sstream>
+
+// proteins are formatted for output in parallel in chunks of kWriteChunkSize
+// proteins, kWriteChunksPerRound chunks at a time, after which the chunks are
+// written in order
+static const size_t kWriteChunkSize = 1024u;
+static const size_t kWriteChunksPerRound = 64u;
+
 const double ProteinProbEstimator::target_decoy_ratio = 1.0;
 const double ProteinProbEstimator::psmThresholdMayu = 0.90;
 const double ProteinProbEstimator::prior_protein = 0.5;
 bool ProteinProbEstimator::calcProteinLevelProb = false;
 /** Helper functions **/
 
-template<class T> 
-void bootstrap(const vector<T>& in, vector<T>& out, size_t max_size = 1000) {
-  out.clear();
-  double n = in.size();
-  size_t num_draw = min(in.size(), max_size);
-  for (size_t ix = 0; ix < num_draw; ++ix) {
-    size_t draw = (size_t)((double)PseudoRandom::lcg_rand() / ((double)PseudoRandom::kRandMax + (double)1) * n);
-    out.push_back(in[draw]);
-  }
-  // sort in desending order
-  std::sort(out.begin(), out.end());
+namespace {
+  /* orders ranked groups by PEP */
+  struct RankedPepCmp {
+    const std::vector<double>& peps;
+    RankedPepCmp(const std::vector<double>& p) : peps(p) {}
+    bool operator()(size_t a, size_t b) const {
+      return peps[a] < peps[b];
+    }
+  };
 }
 
-
 ProteinProbEstimator::ProteinProbEstimator(bool trivialGrouping, double absenceRatio, 
 					     bool outputEmpirQVal, std::string decoyPattern) : 
-	  trivialGrouping_(trivialGrouping), absenceRatio_(absenceRatio), peptideScores_(NULL), 
-	  numberDecoyProteins_(0u), numberTargetProteins_(0u), usePi0_(true),
+	  rankedOffsets_(1, 0u), trivialGrouping_(trivialGrouping), absenceRatio_(absenceRatio), 
+	  peptideScores_(NULL), numberDecoyProteins_(0u), numberTargetProteins_(0u), usePi0_(true),
 	  outputEmpirQVal_(outputEmpirQVal), decoyPattern_(decoyPattern), fdr_(1.0) {}
 
 ProteinProbEstimator::~ProteinProbEstimator() {
@@ -53,15 +58,10 @@ ProteinProbEstimator::~ProteinProbEstimator() {
   }
   fastReader = 0;
   
-  for(std::multimap<double,std::vector<std::string> >::iterator it = pepProteinMap_.begin();
-        it != pepProteinMap_.end(); it++) {
-	  FreeAll(it->second);
-  }
-      
-  for(std::map<const std::string,Protein*>::iterator it = proteins_.begin(); 
+  for(std::vector<Protein*>::iterator it = proteins_.begin(); 
         it != proteins_.end(); it++) {
-	  if(it->second)
-	    delete it->second;
+	  if(*it)
+	    delete *it;
   }
 }
 
@@ -105,6 +105,7 @@ void ProteinProbEstimator::computeFDR() {
 }
 
 void ProteinProbEstimator::computeStatistics() {
+  sortRankedGroups();
   if (pvalues.size() == 0) {
     estimatePValues();
   }
@@ -206,14 +207,11 @@ double ProteinProbEstimator::estimatePriors() {
 }
 
 void ProteinProbEstimator::getCombinedList(std::vector<std::pair<double , bool> > &combined) {
-  for (std::multimap<double,std::vector<std::string> >::const_iterator it = pepProteinMap_.begin();
-       it != pepProteinMap_.end(); it++) {
-    double prob = it->first;
-    std::vector<std::string> proteinList = it->second;
-    for(std::vector<std::string>::const_iterator itP = proteinList.begin();
-	        itP != proteinList.end(); itP++) {
-      std::string proteinName = *itP;
-      bool isdecoy = proteins_[proteinName]->getIsDecoy();
+  combined.reserve(rankedProteins_.size());
+  for (size_t group = 0; group < rankedPeps_.size(); group++) {
+    double prob = rankedPeps_[group];
+    for (size_t k = rankedOffsets_[group]; k < rankedOffsets_[group + 1]; k++) {
+      bool isdecoy = proteins_[rankedProteins_[k]]->getIsDecoy();
       combined.push_back(std::make_pair(prob,isdecoy));
     }
   }
@@ -267,12 +265,12 @@ void ProteinProbEstimator::getTPandPFfromPeptides(double psm_threshold,
    * This creates sometimes a difference in the number of TP and FP proteins between percolator and Mayus 
    * which causes a slight difference in the estimated protein FDR
    */
-  for (std::map<std::string,Protein*>::const_iterator it = proteins_.begin();
-       it != proteins_.end(); it++) {
+  for (size_t proteinId = 0; proteinId < proteins_.size(); proteinId++) {
+    if (!proteins_[proteinId]) continue;
     unsigned num_target_confident = 0;
     unsigned num_decoy_confident = 0;
-    std::string protname = it->first;
-    std::vector<Protein::Peptide*> peptides = it->second->getPeptides();
+    const std::string& protname = proteinIndex_.getName(proteinId);
+    const std::vector<Protein::Peptide*>& peptides = proteins_[proteinId]->getPeptides();
     for(std::vector<Protein::Peptide*>::const_iterator itP = peptides.begin();
           itP != peptides.end(); itP++) {
       Protein::Peptide *p = *itP;
@@ -291,7 +289,7 @@ void ProteinProbEstimator::getTPandPFfromPeptides(double psm_threshold,
 }
 
 double ProteinProbEstimator::estimatePi0(const unsigned int numBoot) {
-  std::vector<double> pBoot, lambdas, pi0s, mse;
+  std::vector<double> lambdas, pi0s, mse;
   std::vector<double>::iterator start;
   unsigned int numLambda = 100;
   double maxLambda = 0.5;
@@ -317,22 +315,8 @@ double ProteinProbEstimator::estimatePi0(const unsigned int numBoot) {
     return -1;
   }
   double minPi0 = *min_element(pi0s.begin(), pi0s.end());
-  // Initialize the vector mse with zeroes.
-  fill_n(back_inserter(mse), pi0s.size(), 0.0);
   // Examine which lambda level that is most stable under bootstrap
-  for (unsigned int boot = 0; boot < numBoot; ++boot) {
-    // Create an array of bootstrapped p-values, and sort in ascending order.
-    bootstrap<double> (pvalues, pBoot);
-    n = pBoot.size();
-    for (unsigned int ix = 0; ix < lambdas.size(); ++ix) 
-    {
-      start = lower_bound(pBoot.begin(), pBoot.end(), lambdas[ix]);
-      double Wl = (double)distance(start, pBoot.end());
-      double pi0Boot = Wl / n / (1 - lambdas[ix]);
-      // Estimated mean-squared error.
-      mse[ix] += (pi0Boot - minPi0) * (pi0Boot - minPi0);
-    }
-  }
+  PosteriorEstimator::getPi0BootstrapMSE(pvalues, lambdas, minPi0, numBoot, mse);
   // Which index did the iterator get?
   unsigned int minIx = distance(mse.begin(), min_element(mse.begin(),mse.end()));
   double pi0 = max(min(pi0s[minIx], 1.0), 0.0);
@@ -342,11 +326,11 @@ double ProteinProbEstimator::estimatePi0(const unsigned int numBoot) {
 unsigned ProteinProbEstimator::getQvaluesBelowLevel(double level) {
   std::set<int> identifiedGroupIds;
   unsigned nP = 0;
-  for (std::map<const std::string,Protein*>::const_iterator myP = proteins_.begin(); 
+  for (std::vector<Protein*>::const_iterator myP = proteins_.begin(); 
           myP != proteins_.end(); ++myP) {
-    if (myP->second->getQemp() < level && !myP->second->getIsDecoy()) {
+    if (*myP && (*myP)->getQemp() < level && !(*myP)->getIsDecoy()) {
       nP++;
-      identifiedGroupIds.insert(myP->second->getGroupId());
+      identifiedGroupIds.insert((*myP)->getGroupId());
     }
   }
   
@@ -360,11 +344,11 @@ unsigned ProteinProbEstimator::getQvaluesBelowLevel(double level) {
 unsigned ProteinProbEstimator::getQvaluesBelowLevelDecoy(double level) { 
   std::set<int> identifiedGroupIds;
   unsigned nP = 0;
-  for (std::map<const std::string,Protein*>::const_iterator myP = proteins_.begin(); 
+  for (std::vector<Protein*>::const_iterator myP = proteins_.begin(); 
           myP != proteins_.end(); ++myP) {
-    if (myP->second->getQ() < level && myP->second->getIsDecoy()) {
+    if (*myP && (*myP)->getQ() < level && (*myP)->getIsDecoy()) {
       nP++;
-      identifiedGroupIds.insert(myP->second->getGroupId());
+      identifiedGroupIds.insert((*myP)->getGroupId());
     }
   }
   
@@ -381,11 +365,12 @@ void ProteinProbEstimator::estimateQValues() {
   double sum = 0.0;
   double qvalue = 0.0;
   qvalues.clear();
+  qvalues.reserve(rankedProteins_.size());
   
-  for (std::multimap<double,std::vector<std::string> >::const_iterator it = pepProteinMap_.begin(); 
-          it != pepProteinMap_.end(); it++) {
-    int ntargets = countTargets(it->second);
-    int ndecoys = it->second.size() - ntargets;
+  for (size_t group = 0; group < rankedPeps_.size(); group++) {
+    size_t groupSize = rankedOffsets_[group + 1] - rankedOffsets_[group];
+    int ntargets = countRankedTargets(group);
+    int ndecoys = groupSize - ntargets;
     if (trivialGrouping_) {
       if (ntargets > 0) ntargets = 1;
       if (ndecoys > 0) ndecoys = 1;
@@ -394,19 +379,17 @@ void ProteinProbEstimator::estimateQValues() {
     if (ndecoys == 0) {
       //NOTE in case I want to count and use target and decoys proteins while estimating qvalue from PEP
       if (countDecoyQvalue_) {
-        sum += (double)(it->first * (ntargets + ndecoys));
+        sum += (double)(rankedPeps_[group] * (ntargets + ndecoys));
         nP += (ntargets + ndecoys);
       } else {
-        sum += (double)(it->first * ntargets);
+        sum += (double)(rankedPeps_[group] * ntargets);
         nP += ntargets;
       }
     }
     qvalue = (sum * absenceRatio_ / (double)nP);
     if (std::isnan(qvalue) || std::isinf(qvalue) || qvalue > absenceRatio_) qvalue = absenceRatio_;
     
-    for (size_t i = 0; i < it->second.size(); ++i) {
-      qvalues.push_back(qvalue);
-    }
+    qvalues.insert(qvalues.end(), groupSize, qvalue);
   }
   std::partial_sum(qvalues.rbegin(),qvalues.rend(),qvalues.rbegin(),myminfunc);
 }
@@ -420,6 +403,7 @@ void ProteinProbEstimator::estimateQValuesEmp() {
   unsigned numDecoy = 0;
   //pvalues.clear();
   qvaluesEmp.clear();
+  qvaluesEmp.reserve(rankedProteins_.size());
   double targetDecoyRatio = (double)numberTargetProteins_ / (double)numberDecoyProteins_;
   
   if (VERB > 1) {
@@ -432,10 +416,10 @@ void ProteinProbEstimator::estimateQValuesEmp() {
     }
   }
   
-  std::multimap<double,std::vector<std::string> >::const_iterator it;
-  for (it = pepProteinMap_.begin(); it != pepProteinMap_.end(); it++) {
-    numTarget = countTargets(it->second);
-    numDecoy = it->second.size() - numTarget;
+  for (size_t group = 0; group < rankedPeps_.size(); group++) {
+    size_t groupSize = rankedOffsets_[group + 1] - rankedOffsets_[group];
+    numTarget = countRankedTargets(group);
+    numDecoy = groupSize - numTarget;
     if (trivialGrouping_) {
       if (numTarget > 0) numTarget = 1;
       if (numDecoy > 0) numDecoy = 1;
@@ -449,7 +433,7 @@ void ProteinProbEstimator::estimateQValuesEmp() {
     }
     if (std::isnan(qvalue) || std::isinf(qvalue) || qvalue > absenceRatio_) qvalue = absenceRatio_;
     
-    for (size_t i = 0; i < it->second.size(); ++i) {
+    for (size_t i = 0; i < groupSize; ++i) {
       qvaluesEmp.push_back(qvalue);
       /*
       if (numDecoy > 0) {
@@ -464,25 +448,18 @@ void ProteinProbEstimator::estimateQValuesEmp() {
 }
 
 void ProteinProbEstimator::updateProteinProbabilities() {
-  std::vector<double> peps; // posterior error probabilities, not peptides
-  std::vector<std::vector<std::string> > proteinNames;
-  std::transform(pepProteinMap_.begin(), pepProteinMap_.end(), std::back_inserter(peps), RetrieveKey());
-  std::transform(pepProteinMap_.begin(), pepProteinMap_.end(), std::back_inserter(proteinNames), RetrieveValue());
-  unsigned protIdx = 0;
-  for (unsigned pepIdx = 0; pepIdx < peps.size(); pepIdx++) {
-    double pep = peps[pepIdx];
-    std::vector<std::string> proteinlist = proteinNames[pepIdx];
-    for (unsigned j = 0; j < proteinlist.size(); j++) { 
+  for (unsigned pepIdx = 0; pepIdx < rankedPeps_.size(); pepIdx++) {
+    double pep = rankedPeps_[pepIdx]; // posterior error probability, not peptide
+    for (size_t protIdx = rankedOffsets_[pepIdx]; protIdx < rankedOffsets_[pepIdx + 1]; protIdx++) { 
       int protGroupId = protIdx + 1;
       if (trivialGrouping_) protGroupId = pepIdx + 1;
       
-      std::string proteinName = proteinlist[j];
-      proteins_[proteinName]->setPEP(pep);
-      proteins_[proteinName]->setQ(qvalues[protIdx]);
-      proteins_[proteinName]->setQemp(qvaluesEmp[protIdx]);
-      proteins_[proteinName]->setP(pvalues[protIdx]);
-      proteins_[proteinName]->setGroupId(protGroupId);
-      ++protIdx;
+      Protein* protein = proteins_[rankedProteins_[protIdx]];
+      protein->setPEP(pep);
+      protein->setQ(qvalues[protIdx]);
+      protein->setQemp(qvaluesEmp[protIdx]);
+      protein->setP(pvalues[protIdx]);
+      protein->setGroupId(protGroupId);
     }
   }
 
@@ -496,17 +473,18 @@ void ProteinProbEstimator::setTargetandDecoysNames() {
       Protein::Peptide *peptide = new Protein::Peptide(
           psm->pPSM->getPeptideSequence(), psm->isDecoy(),
           psm->p, psm->pep, psm->q, psm->score);
-      if (proteins_.find(*protIt) == proteins_.end()) {
-	      Protein *newprotein = new Protein(*protIt, psm->isDecoy(), peptide, ++numGroups);
-	      proteins_.insert(std::make_pair(*protIt,newprotein));
-	
+      int proteinId = proteinIndex_.find(*protIt);
+      if (proteinId == ProteinIdIndex::kNotFound) {
 	      if (psm->isDecoy()) {
 	        falsePosSet.insert(*protIt);
 	      } else {
 	        truePosSet.insert(*protIt);
 	      }
+	      
+	      Protein *newprotein = new Protein(*protIt, psm->isDecoy(), peptide, ++numGroups);
+	      addProtein(*protIt, newprotein);
       } else {
-      	proteins_[*protIt]->setPeptide(peptide);
+      	proteins_[proteinId]->setPeptide(peptide);
       }
     }
   }  
@@ -521,6 +499,64 @@ void ProteinProbEstimator::addProteinDb(bool isDecoy, std::string name, std::str
     targetProteins.insert(std::make_pair(name,std::make_pair(sequence,length)));
 }
 
+int ProteinProbEstimator::addProtein(const std::string& proteinName, Protein* protein) {
+  int proteinId = proteinIndex_.insert(proteinName);
+  assert(proteinId == (int)proteins_.size());
+  proteins_.push_back(protein);
+  isTargetName_.push_back(isTarget(proteinName));
+  return proteinId;
+}
+
+void ProteinProbEstimator::removeProtein(int proteinId) {
+  delete proteins_[proteinId];
+  proteins_[proteinId] = NULL;
+}
+
+void ProteinProbEstimator::clearRankedGroups() {
+  rankedPeps_.clear();
+  rankedOffsets_.assign(1, 0u);
+  rankedProteins_.clear();
+}
+
+void ProteinProbEstimator::addRankedGroup(double pep, const std::vector<int> &proteinIds) {
+  rankedPeps_.push_back(pep);
+  rankedProteins_.insert(rankedProteins_.end(), proteinIds.begin(), proteinIds.end());
+  rankedOffsets_.push_back(rankedProteins_.size());
+}
+
+void ProteinProbEstimator::sortRankedGroups() {
+  size_t numGroups = rankedPeps_.size();
+  size_t group = 1;
+  while (group < numGroups && !(rankedPeps_[group] < rankedPeps_[group - 1])) group++;
+  if (group >= numGroups) return;
+  
+  std::vector<size_t> order(numGroups);
+  for (group = 0; group < numGroups; group++) order[group] = group;
+  std::stable_sort(order.begin(), order.end(), RankedPepCmp(rankedPeps_));
+  
+  std::vector<double> peps(numGroups);
+  std::vector<size_t> offsets(1, 0u);
+  std::vector<int> proteinIds;
+  proteinIds.reserve(rankedProteins_.size());
+  for (size_t k = 0; k < numGroups; k++) {
+    peps[k] = rankedPeps_[order[k]];
+    proteinIds.insert(proteinIds.end(), rankedProteins_.begin() + rankedOffsets_[order[k]], 
+                      rankedProteins_.begin() + rankedOffsets_[order[k] + 1]);
+    offsets.push_back(proteinIds.size());
+  }
+  rankedPeps_.swap(peps);
+  rankedOffsets_.swap(offsets);
+  rankedProteins_.swap(proteinIds);
+}
+
+unsigned ProteinProbEstimator::countRankedTargets(size_t group) const {
+  unsigned count = 0;
+  for (size_t k = rankedOffsets_[group]; k < rankedOffsets_[group + 1]; k++) {
+    if (isTargetName_[rankedProteins_[k]]) count++;
+  }
+  return count;
+}
+
 unsigned ProteinProbEstimator::countTargets(const std::vector<std::string> &proteinList) {
   unsigned count = 0;
   for (std::vector<std::string>::const_iterator it = proteinList.begin(); it != proteinList.end(); it++) {
@@ -566,72 +602,127 @@ bool ProteinProbEstimator::isTarget(const std::string& proteinName) {
 }
 
 
+void ProteinProbEstimator::getProteinsSortedByProb(std::vector<Protein*> &proteins) {
+  proteins.clear();
+  for (size_t proteinId = 0; proteinId < proteins_.size(); proteinId++) {
+    if (proteins_[proteinId]) proteins.push_back(proteins_[proteinId]);
+  }
+  std::sort(proteins.begin(), proteins.end(), IntCmpProb());
+}
+
 void ProteinProbEstimator::writeOutputToXML(string xmlOutputFN, bool outputDecoys) {
-  std::vector<std::pair<std::string,Protein*> > myvec(proteins_.begin(), proteins_.end());
-  std::sort(myvec.begin(), myvec.end(), IntCmpProb());
+  std::vector<Protein*> myvec, outputvec;
+  getProteinsSortedByProb(myvec);
+  for (std::vector<Protein*>::const_iterator it = myvec.begin(); 
+	      it != myvec.end(); it++) {
+    if ( (!outputDecoys && !(*it)->getIsDecoy()) || (outputDecoys)) {
+      outputvec.push_back(*it);
+    }
+  }
 
   ofstream os;
   os.open(xmlOutputFN.data(), ios::app);
   // append PROTEINs tag
   os << "  <proteins>" << endl;
-  for (std::vector<std::pair<std::string,Protein*> > ::const_iterator myP = myvec.begin(); 
-	      myP != myvec.end(); myP++) {
-    if ( (!outputDecoys && !myP->second->getIsDecoy()) || (outputDecoys)) {
-      os << "    <protein p:protein_id=\"" << myP->second->getName() << "\"";
-	    if (outputDecoys) {
-	      if (myP->second->getIsDecoy()) 
-	        os << " p:decoy=\"true\"";
-	      else  
-	        os << " p:decoy=\"false\"";
-	    }
-	    os << ">" << endl;
-	    
-	    os << "      <pep>" << scientific << myP->second->getPEP() << "</pep>" << endl;
-	  
-	    if (outputEmpirQVal_) {
-	      os << "      <q_value_emp>" << scientific << myP->second->getQemp() << "</q_value_emp>\n";
-	    }
-	  
-	    os << "      <q_value>" << scientific << myP->second->getQ() << "</q_value>\n";
-	    
-	    if (outputEmpirQVal_) {
-	      os << "      <p_value>" << scientific << myP->second->getP() << "</p_value>\n";
-	    }
-	  
-	    std::vector<Protein::Peptide*> peptides = myP->second->getPeptides();
-	    for (std::vector<Protein::Peptide*>::const_iterator peptIt = peptides.begin(); 
-	        peptIt != peptides.end(); peptIt++) {
-	      if ((*peptIt)->name != "") {
-	        os << "      <peptide_seq seq=\"" << (*peptIt)->name << "\"/>"<<endl;
-	      }
-	    }
-	    os << "    </protein>" << endl;
-	  }
-  }
-    
+  writeProteins(os, outputvec, true, outputDecoys);
   os << "  </proteins>" << endl << endl;
   os.close();
 }
 
 void ProteinProbEstimator::print(ostream& myout, bool decoy) {
   
-  std::vector<std::pair<std::string,Protein*> > myvec(proteins_.begin(), proteins_.end());
-  std::sort(myvec.begin(), myvec.end(), IntCmpProb());
+  std::vector<Protein*> myvec, outputvec;
+  getProteinsSortedByProb(myvec);
+  for (std::vector<Protein*>::const_iterator it = myvec.begin(); 
+	        it != myvec.end(); it++) {
+    if( (decoy && (*it)->getIsDecoy()) || (!decoy && !(*it)->getIsDecoy())) {
+      outputvec.push_back(*it);
+    }
+  }
   
   myout << "ProteinId\tProteinGroupId\tq-value\tposterior_error_prob\tpeptideIds" << std::endl;
-  
-  for (std::vector<std::pair<std::string,Protein*> > ::const_iterator myP = myvec.begin(); 
-	        myP != myvec.end(); myP++) {
-    if( (decoy && myP->second->getIsDecoy()) || (!decoy && !myP->second->getIsDecoy())) {
-      myout << myP->second->getName() << "\t" << myP->second->getGroupId() << "\t" 
-            << myP->second->getQemp() << "\t" << myP->second->getPEP() << "\t";
-      std::vector<Protein::Peptide*> peptides = myP->second->getPeptides();
-      for(std::vector<Protein::Peptide*>::const_iterator peptIt = peptides.begin(); peptIt != peptides.end(); peptIt++) {
-        if((*peptIt)->name != "") {
-          myout << (*peptIt)->name << "  ";
+  writeProteins(myout, outputvec, false, decoy);
+  myout.flush();
+}
+
+void ProteinProbEstimator::writeProteins(ostream& os, 
+    const std::vector<Protein*> &proteins, bool xml, bool outputDecoys) {
+  size_t numProteins = proteins.size();
+  size_t roundSize = kWriteChunkSize * kWriteChunksPerRound;
+  std::vector<std::string> chunkTexts(kWriteChunksPerRound);
+#pragma omp parallel
+  {
+    // every thread formats all its chunks in the same buffer, which has the 
+    // formatting flags of the output stream
+    std::ostringstream buffer;
+    buffer.copyfmt(os);
+    for (size_t roundStart = 0; roundStart < numProteins; roundStart += roundSize) {
+      size_t roundEnd = std::min(roundStart + roundSize, numProteins);
+      int numChunks = (int)((roundEnd - roundStart + kWriteChunkSize - 1) / kWriteChunkSize);
+#pragma omp for schedule(dynamic, 1)
+      for (int chunk = 0; chunk < numChunks; chunk++) {
+        buffer.str("");
+        size_t chunkStart = roundStart + chunk * kWriteChunkSize;
+        size_t chunkEnd = std::min(chunkStart + kWriteChunkSize, roundEnd);
+        for (size_t k = chunkStart; k < chunkEnd; k++) {
+          if (xml) {
+            formatProteinXML(buffer, proteins[k], outputDecoys);
+          } else {
+            formatProteinRow(buffer, proteins[k]);
+          }
         }
+        chunkTexts[chunk] = buffer.str();
       }
-      myout << std::endl;
+#pragma omp single
+      {
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+          os.write(chunkTexts[chunk].data(), chunkTexts[chunk].size());
+        }
+      }
+    }
+  }
+}
+
+void ProteinProbEstimator::formatProteinRow(ostream& os, const Protein* myP) {
+  os << myP->getName() << "\t" << myP->getGroupId() << "\t" 
+     << myP->getQemp() << "\t" << myP->getPEP() << "\t";
+  const std::vector<Protein::Peptide*>& peptides = myP->getPeptides();
+  for(std::vector<Protein::Peptide*>::const_iterator peptIt = peptides.begin(); peptIt != peptides.end(); peptIt++) {
+    if((*peptIt)->name != "") {
+      os << (*peptIt)->name << "  ";
+    }
+  }
+  os << "\n";
+}
+
+void ProteinProbEstimator::formatProteinXML(ostream& os, const Protein* myP, bool outputDecoys) {
+  os << "    <protein p:protein_id=\"" << myP->getName() << "\"";
+  if (outputDecoys) {
+    if (myP->getIsDecoy()) 
+      os << " p:decoy=\"true\"";
+    else  
+      os << " p:decoy=\"false\"";
+  }
+  os << ">\n";
+  
+  os << "      <pep>" << scientific << myP->getPEP() << "</pep>\n";
+  
+  if (outputEmpirQVal_) {
+    os << "      <q_value_emp>" << scientific << myP->getQemp() << "</q_value_emp>\n";
+  }
+  
+  os << "      <q_value>" << scientific << myP->getQ() << "</q_value>\n";
+  
+  if (outputEmpirQVal_) {
+    os << "      <p_value>" << scientific << myP->getP() << "</p_value>\n";
+  }
+  
+  const std::vector<Protein::Peptide*>& peptides = myP->getPeptides();
+  for (std::vector<Protein::Peptide*>::const_iterator peptIt = peptides.begin(); 
+      peptIt != peptides.end(); peptIt++) {
+    if ((*peptIt)->name != "") {
+      os << "      <peptide_seq seq=\"" << (*peptIt)->name << "\"/>\n";
     }
   }
+  os << "    </protein>\n";
 }
@@ -30,28 +30,30 @@
 #include "Globals.h"
 #include "ProteinFDRestimator.h"
 #include "Protein.h"
+#include "ProteinIdIndex.h"
 #include "Scores.h"
 #include "PseudoRandom.h"
+#include "PosteriorEstimator.h"
 
 /** set of helper functions to sort data structures and some operations overloaded **/
 struct IntCmpProb {
-  bool operator()(const std::pair<const std::string,Protein*> &lhs, const std::pair<const std::string,Protein*> &rhs) {
-    return (  (lhs.second->getPEP() < rhs.second->getPEP())
-         || ( (lhs.second->getPEP() == rhs.second->getPEP()) && (lhs.second->getQ() < rhs.second->getQ()) )
-         || ( (lhs.second->getPEP() == rhs.second->getPEP()) && (lhs.second->getQ() == rhs.second->getQ())
-            && (lhs.second->getGroupId() < rhs.second->getGroupId()) )
-         || ( (lhs.second->getPEP() == rhs.second->getPEP()) && (lhs.second->getQ() == rhs.second->getQ())
-            && (lhs.second->getGroupId() == rhs.second->getGroupId()) 
-            && (lhs.second->getName() < rhs.second->getName()) )  
+  bool operator()(const Protein* lhs, const Protein* rhs) const {
+    return (  (lhs->getPEP() < rhs->getPEP())
+         || ( (lhs->getPEP() == rhs->getPEP()) && (lhs->getQ() < rhs->getQ()) )
+         || ( (lhs->getPEP() == rhs->getPEP()) && (lhs->getQ() == rhs->getQ())
+            && (lhs->getGroupId() < rhs->getGroupId()) )
+         || ( (lhs->getPEP() == rhs->getPEP()) && (lhs->getQ() == rhs->getQ())
+            && (lhs->getGroupId() == rhs->getGroupId()) 
+            && (lhs->getName() < rhs->getName()) )  
     );
   }
 };
 
 struct IntCmpScore {
-  bool operator()(const std::pair<const std::string,Protein*> &lhs, const std::pair<const std::string,Protein*> &rhs) {
-    return ( lhs.second->getScore() < rhs.second->getScore()
-         || (lhs.second->getScore() == rhs.second->getScore() 
-            && lhs.second->getName() < rhs.second->getName())
+  bool operator()(const Protein* lhs, const Protein* rhs) const {
+    return ( lhs->getScore() < rhs->getScore()
+         || (lhs->getScore() == rhs->getScore() 
+            && lhs->getName() < rhs->getName())
     );
   }
 };
@@ -60,20 +62,6 @@ inline double myminfunc(double a, double b) {
   return a > b ? b : a;
 }
 
-struct RetrieveKey {
-  template <typename T>
-  typename T::first_type operator()(T keyValuePair) const {
-    return keyValuePair.first;
-  }
-};
-    
-struct RetrieveValue {
-  template <typename T>
-  typename T::second_type operator()(T keyValuePair) const {
-    return keyValuePair.second;
-  }
-};
-
 /*
 * ProteinProbEstimator is a class that computes probabilities and statistics based
 * on provided proteins from the set of scored peptides from percolator.
@@ -151,8 +139,8 @@ class ProteinProbEstimator {
   /** populate the list of proteins**/
   void setTargetandDecoysNames();
   
-  /** return the data structure for the proteins **/
-  std::map<const std::string,Protein*> getProteins() { return proteins_; }
+  /** return the proteins, indexed by protein id; removed proteins are NULL **/
+  const std::vector<Protein*>& getProteins() const { return proteins_; }
   
   /** add proteins read from the database **/
   void addProteinDb(bool isDecoy, std::string name, std::string sequence, double length);
@@ -181,9 +169,29 @@ class ProteinProbEstimator {
   bool isTarget(const std::string& proteinName);
   bool isDecoy(const std::string& proteinName);
   
+  /** adds a protein under a name that has not been added before, and 
+   * returns its protein id **/
+  int addProtein(const std::string& proteinName, Protein* protein);
+  /** deletes a protein, so that it is not reported **/
+  void removeProtein(int proteinId);
+  
+  /** functions to build the list of protein groups ranked by PEP, groups with 
+   * the same PEP stay in the order they were added **/
+  void clearRankedGroups();
+  void addRankedGroup(double pep, const std::vector<int> &proteinIds);
+  void sortRankedGroups();
+  unsigned countRankedTargets(size_t group) const;
+  
    /** print a tab delimited list of proteins probabilities in a file or stdout**/
   void print(ostream& myout, bool decoy=false);
   
+  /** write the tab delimited rows or the XML elements of the proteins in order, 
+   * formatting them in parallel chunks **/
+  void writeProteins(ostream& os, const std::vector<Protein*> &proteins, 
+        bool xml, bool outputDecoys);
+  void formatProteinRow(ostream& os, const Protein* protein);
+  void formatProteinXML(ostream& os, const Protein* protein, bool outputDecoys);
+  
   /** function that extracts a list of proteins from the peptides that have a qvalue lower than psmThresholdMayu
    * this function is used to estimate the protein FDR**/
   void getTPandPFfromPeptides(double threshold, std::set<std::string> &numberTP, 
@@ -195,6 +203,9 @@ class ProteinProbEstimator {
   /** this function generates a vector of pair protein pep and label **/
   void getCombinedList(std::vector<std::pair<double , bool> > &combined);
   
+   /** the proteins that have not been removed, ordered by IntCmpProb **/
+  void getProteinsSortedByProb(std::vector<Protein*> &proteins);
+  
    /** update the proteins with the computed qvalues and pvalues**/
   void updateProteinProbabilities();
   
@@ -213,8 +224,16 @@ class ProteinProbEstimator {
   /** variables **/
   std::set<string> truePosSet, falsePosSet;
   ProteinFDRestimator *fastReader;
-  std::map<const std::string,Protein*> proteins_;
-  std::multimap<double,std::vector<std::string> > pepProteinMap_;
+  /* the proteins are indexed by a protein id, which proteinIndex_ gives 
+     for their name, so that the names are only needed for input and output */
+  ProteinIdIndex proteinIndex_;
+  std::vector<Protein*> proteins_;
+  std::vector<bool> isTargetName_;
+  /* the protein groups ranked by PEP, the proteins of group k are 
+     rankedProteins_[rankedOffsets_[k]] up to rankedProteins_[rankedOffsets_[k+1]] */
+  std::vector<double> rankedPeps_;
+  std::vector<size_t> rankedOffsets_;
+  std::vector<int> rankedProteins_;
   std::map<std::string,std::pair<std::string,double> > targetProteins;
   std::map<std::string,std::pair<std::string,double> > decoyProteins;
   std::vector<double> qvalues;
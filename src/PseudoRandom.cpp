@@ -22,7 +22,19 @@ unsigned long PseudoRandom::seed_ = 1u;
 // Park–Miller random number generator
 // from wikipedia
 unsigned long PseudoRandom::lcg_rand() {
-  //uint64_t
-  seed_ = (seed_ * 279470273u) % 4294967291u;
-  return seed_;
+  return lcg_rand(seed_);
+}
+
+// jumps ahead by raising the multiplier to the number of steps by repeated
+// squaring, in O(log(steps)) multiplications
+unsigned long PseudoRandom::lcg_skip(unsigned long seed, unsigned long steps) {
+  unsigned long multiplier = 279470273u;
+  while (steps > 0) {
+    if (steps & 1u) {
+      seed = (seed * multiplier) % 4294967291u;
+    }
+    multiplier = (multiplier * multiplier) % 4294967291u;
+    steps >>= 1;
+  }
+  return seed;
 }
@@ -29,6 +29,14 @@ class PseudoRandom {
  public:
   inline static void setSeed(unsigned long s) { seed_ = s; }
   static unsigned long lcg_rand();
+  // same generator on a caller owned state, for independent streams
+  inline static unsigned long lcg_rand(unsigned long& seed) {
+    seed = (seed * 279470273u) % 4294967291u;
+    return seed;
+  }
+  inline static unsigned long getSeed() { return seed_; }
+  // state of the generator after the given number of draws from seed
+  static unsigned long lcg_skip(unsigned long seed, unsigned long steps);
   const static unsigned long kRandMax = 4294967291u;
  protected:
   static unsigned long seed_;
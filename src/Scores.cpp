@@ -27,6 +27,7 @@
 #include <vector>
 #include <string>
 #include <cmath>
+#include <cstring>
 #include <memory>
 
 #include "DataSet.h"
@@ -37,6 +38,7 @@
 #include "PosteriorEstimator.h"
 #include "ssl.h"
 #include "MassHandler.h"
+#include "InternTable.h"
 
 inline bool operator>(const ScoreHolder& one, const ScoreHolder& other) {
   return (one.score > other.score) 
@@ -56,6 +58,62 @@ inline bool operator<(const ScoreHolder& one, const ScoreHolder& other) {
             one.pPSM->expMass == other.pPSM->expMass && one.label < other.label);
 }
 
+// findGroupRepresentatives spreads the PSMs over 2^kGroupShardBits
+// independent InternTables, selected by the top bits of the hash
+static const int kGroupShardBits = 6;
+static const int kNumGroupShards = 1 << kGroupShardBits;
+
+/**
+ * 64-bit FNV-1a hash of the peptide sequence without its flanks, combined
+ * with the label, i.e. equal for PSMs that weedOutRedundant collapses
+ */
+inline uint64_t peptideLabelHash(const ScoreHolder& sh) {
+  const std::string& peptide = sh.pPSM->getFullPeptideSequence();
+  uint64_t hash = fnv1a(peptide.data() + 2, peptide.size() - 4);
+  return fnv1aByte(hash, static_cast<unsigned char>(sh.label + 2));
+}
+
+inline bool samePeptideLabel(const ScoreHolder& one, const ScoreHolder& other) {
+  const std::string& pep1 = one.pPSM->getFullPeptideSequence();
+  const std::string& pep2 = other.pPSM->getFullPeptideSequence();
+  return one.label == other.label && pep1.size() == pep2.size() &&
+         pep1.compare(2, pep1.size() - 4, pep2, 2, pep2.size() - 4) == 0;
+}
+
+/**
+ * 64-bit FNV-1a hash of the scan number and experimental mass, i.e. equal for
+ * PSMs that compete in weedOutRedundantTDC
+ */
+inline uint64_t scanMassHash(const ScoreHolder& sh) {
+  uint64_t massBits = 0u;
+  memcpy(&massBits, &sh.pPSM->expMass, sizeof(double));
+  uint64_t hash = kFnv1aOffsetBasis;
+  for (int byte = 0; byte < 4; ++byte) {
+    hash = fnv1aByte(hash, (sh.pPSM->scan >> (8 * byte)) & 0xffu);
+  }
+  for (int byte = 0; byte < 8; ++byte) {
+    hash = fnv1aByte(hash, (massBits >> (8 * byte)) & 0xffu);
+  }
+  return hash;
+}
+
+inline bool sameScanMass(const ScoreHolder& one, const ScoreHolder& other) {
+  return UniqueScanMassCharge()(one, other);
+}
+
+/* checks a PSM of an InternTable against the key of the PSM at idx */
+struct SameKeyAs {
+  const std::vector<ScoreHolder>& scores;
+  bool (*sameKey)(const ScoreHolder&, const ScoreHolder&);
+  size_t idx;
+  SameKeyAs(const std::vector<ScoreHolder>& s, 
+            bool (*same)(const ScoreHolder&, const ScoreHolder&), size_t i) :
+      scores(s), sameKey(same), idx(i) {}
+  bool operator()(unsigned int other) const {
+    return sameKey(scores[other], scores[idx]);
+  }
+};
+
 inline double truncateTo(double truncateMe, const char* length) {
   char truncated[64];
   char format[64];
@@ -141,8 +199,9 @@ void ScoreHolder::printPeptide(ostream& os, bool printDecoys, bool printExpMass,
     os << "      <psm_ids>" << endl;
     
     // output all psms that contain the peptide
-    std::vector<PSMDescription*>::const_iterator psmIt = fullset.getPsms(pPSM).begin();
-    for ( ; psmIt != fullset.getPsms(pPSM).end() ; ++psmIt) {
+    std::pair<Scores::PsmIterator, Scores::PsmIterator> psms = fullset.getPsms(pPSM);
+    Scores::PsmIterator psmIt = psms.first;
+    for ( ; psmIt != psms.second ; ++psmIt) {
       os << "        <psm_id>" << (*psmIt)->getId() << "</psm_id>" << endl;
     }
     os << "      </psm_ids>" << endl;
@@ -170,6 +229,15 @@ void Scores::postMergeStep() {
   totalNumberOfTargets_ = count_if(scores_.begin(),
       scores_.end(),
       mem_fun_ref(&ScoreHolder::isTarget));
+  postSelectionStep();
+}
+
+/**
+ * Counterpart of postMergeStep for routines that select a subset of the
+ * PSMs without changing their order and have already counted the targets
+ * and decoys, i.e. it sets the size ratio and pi0 without sorting.
+ */
+void Scores::postSelectionStep() {
   targetDecoySizeRatio_ = totalNumberOfTargets_ / max(1.0, (double)totalNumberOfDecoys_);
   checkSeparationAndSetPi0();
 }
@@ -577,65 +645,167 @@ void Scores::generatePositiveTrainingSet(AlgIn& data, const double fdr,
   data.m = ix2;
 }
 
+/**
+ * Groups the PSMs on a key and finds the first PSM of each group in the
+ * current order of scores_. The caller provides a hash of the key for every
+ * PSM and a comparison for verifying hash collisions. The hashes are split
+ * over kNumGroupShards InternTables, selected by the top bits of
+ * the hash, which are filled in parallel. Each shard visits its PSMs in the
+ * order of scores_, so the outcome does not depend on the number of threads.
+ * @param hashes hash of the key of each PSM in scores_
+ * @param sameKey returns true if two PSMs have the same key
+ * @param representative on return the index of the first PSM of each PSM's group
+ */
+void Scores::findGroupRepresentatives(const std::vector<uint64_t>& hashes,
+    bool (*sameKey)(const ScoreHolder&, const ScoreHolder&),
+    std::vector<size_t>& representative) const {
+  size_t numPsms = scores_.size();
+  // bucket the PSMs by shard, keeping their order within each shard
+  std::vector<size_t> shardOffsets(kNumGroupShards + 1, 0u);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    ++shardOffsets[(hashes[idx] >> (64 - kGroupShardBits)) + 1];
+  }
+  for (int shard = 0; shard < kNumGroupShards; ++shard) {
+    shardOffsets[shard + 1] += shardOffsets[shard];
+  }
+  std::vector<size_t> shardMembers(numPsms);
+  std::vector<size_t> shardFill(shardOffsets.begin(), shardOffsets.end() - 1);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    shardMembers[shardFill[hashes[idx] >> (64 - kGroupShardBits)]++] = idx;
+  }
+  
+  representative.resize(numPsms);
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int shard = 0; shard < kNumGroupShards; ++shard) {
+    size_t first = shardOffsets[shard], last = shardOffsets[shard + 1];
+    InternTable table(last - first);
+    for (size_t member = first; member < last; ++member) {
+      size_t idx = shardMembers[member];
+      representative[idx] = table.intern(hashes[idx], 
+          SameKeyAs(scores_, sameKey, idx), static_cast<unsigned int>(idx));
+    }
+  }
+}
+
+void Scores::sortIfNeeded() {
+  for (size_t idx = 1u; idx < scores_.size(); ++idx) {
+    if (scores_[idx] > scores_[idx - 1]) {
+      sort(scores_.begin(), scores_.end(), greater<ScoreHolder> ());
+      return;
+    }
+  }
+}
+
 /**
  * Routine that sees to that only unique peptides are kept (used for analysis
- * on peptide-fdr rather than psm-fdr)
+ * on peptide-fdr rather than psm-fdr). The best scoring PSM of each
+ * peptide/label combination is kept and all its PSMs are registered, in
+ * descending score order, as the peptide's PSMs. Instead of sorting on the
+ * peptide strings, the PSMs are grouped on a hash of their peptide and label.
+ * Ties in score are resolved by the order of greater<ScoreHolder>. The
+ * peptides stay in score order, so calcQ and calcPep can follow directly.
  */
 void Scores::weedOutRedundant() {
-  // lexicographically order the scores_ (based on peptides names,labels and scores)
-  std::sort(scores_.begin(), scores_.end(), lexicOrderProb());
+  sortIfNeeded();
+  size_t numPsms = scores_.size();
+  std::vector<uint64_t> hashes(numPsms);
+  #pragma omp parallel for schedule(static)
+  for (int idx = 0; idx < static_cast<int>(numPsms); ++idx) {
+    hashes[idx] = peptideLabelHash(scores_[idx]);
+  }
+  std::vector<size_t> representative;
+  findGroupRepresentatives(hashes, samePeptideLabel, representative);
   
-  /*
-  * much simpler version but it does not fill up the peptide-PSM map:
-  * scores_.erase(std::unique(scores_.begin(), scores_.end(), mycmp), scores_.end());
-  */
+  // number the peptides in score order and lay out their PSM lists
+  std::vector<size_t> peptideIdx(numPsms);
+  size_t numPeptides = 0u;
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    if (representative[idx] == idx) {
+      peptideIdx[idx] = numPeptides++;
+    } else {
+      peptideIdx[idx] = peptideIdx[representative[idx]];
+    }
+  }
+  peptidePsmOffsets_.assign(numPeptides + 1, 0u);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    ++peptidePsmOffsets_[peptideIdx[idx] + 1];
+  }
+  for (size_t pep = 0u; pep < numPeptides; ++pep) {
+    peptidePsmOffsets_[pep + 1] += peptidePsmOffsets_[pep];
+  }
+  peptidePsms_.resize(numPsms);
+  std::vector<size_t> fill(peptidePsmOffsets_.begin(), peptidePsmOffsets_.end() - 1);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    peptidePsms_[fill[peptideIdx[idx]]++] = scores_[idx].pPSM;
+  }
   
-  std::string previousPeptide = "";
-  int previousLabel = 0;
+  // the first PSM of each peptide, taken in score order, directly gives the
+  // peptide level ranking, so the list is compacted in place without sorting
+  peptideIndex_.clear();
+  peptideIndex_.reserve(numPeptides);
+  totalNumberOfTargets_ = 0;
+  totalNumberOfDecoys_ = 0;
   size_t lastWrittenIdx = 0u;
-  for (size_t idx = 0u; idx < scores_.size(); ++idx){
-    std::string currentPeptide = scores_.at(idx).pPSM->getPeptideSequence();
-    int currentLabel = scores_.at(idx).label;
-    if (currentPeptide != previousPeptide || currentLabel != previousLabel) {
-      // insert as a new score
-      scores_.at(lastWrittenIdx++) = scores_.at(idx);
-      previousPeptide = currentPeptide;
-      previousLabel = currentLabel;
-    }
-    // append the psm
-    peptidePsmMap_[scores_.at(lastWrittenIdx - 1).pPSM].push_back(scores_.at(idx).pPSM);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    if (representative[idx] == idx) {
+      peptideIndex_.push_back(std::make_pair(scores_[idx].pPSM, lastWrittenIdx));
+      if (scores_[idx].isTarget()) {
+        ++totalNumberOfTargets_;
+      } else {
+        ++totalNumberOfDecoys_;
+      }
+      scores_[lastWrittenIdx++] = scores_[idx];
+    }
   }
+  std::sort(peptideIndex_.begin(), peptideIndex_.end());
   scores_.resize(lastWrittenIdx);
-  postMergeStep();
+  postSelectionStep();
+}
+
+std::pair<Scores::PsmIterator, Scores::PsmIterator> Scores::getPsms(
+    PSMDescription* pPSM) const {
+  std::vector<std::pair<PSMDescription*, size_t> >::const_iterator it = 
+      std::lower_bound(peptideIndex_.begin(), peptideIndex_.end(), 
+                       std::make_pair(pPSM, size_t(0u)));
+  if (it == peptideIndex_.end() || it->first != pPSM) {
+    return std::make_pair(peptidePsms_.end(), peptidePsms_.end());
+  }
+  return std::make_pair(peptidePsms_.begin() + peptidePsmOffsets_[it->second],
+                        peptidePsms_.begin() + peptidePsmOffsets_[it->second + 1]);
 }
 
 /**
- * Routine that sees to that only unique spectra are kept for TDC
+ * Routine that sees to that only unique spectra are kept for TDC: the best
+ * scoring PSM for each scan and experimental mass is kept, with ties in score
+ * resolved by the order of greater<ScoreHolder>. The PSMs are grouped on a
+ * hash of their scan and experimental mass in a single pass over the scores.
  */
 void Scores::weedOutRedundantTDC() {
-  // order the scores (based on spectra id and score)
-  std::sort(scores_.begin(), scores_.end(), OrderScanMassCharge());  
-  scores_.erase(std::unique(scores_.begin(), scores_.end(), UniqueScanMassCharge()), scores_.end());
+  sortIfNeeded();
+  size_t numPsms = scores_.size();
+  std::vector<uint64_t> hashes(numPsms);
+  #pragma omp parallel for schedule(static)
+  for (int idx = 0; idx < static_cast<int>(numPsms); ++idx) {
+    hashes[idx] = scanMassHash(scores_[idx]);
+  }
+  std::vector<size_t> representative;
+  findGroupRepresentatives(hashes, sameScanMass, representative);
   
-  /* does not actually release memory because of memory fragmentation
-  double previousExpMass = 0.0;
-  unsigned int previousScan = 0u;
+  totalNumberOfTargets_ = 0;
+  totalNumberOfDecoys_ = 0;
   size_t lastWrittenIdx = 0u;
-  for (size_t idx = 0u; idx < scores_.size(); ++idx){
-    double currentExpMass = scores_.at(idx).pPSM->expMass;
-    int currentScan = scores_.at(idx).pPSM->scan;
-    if (currentExpMass != previousExpMass || currentScan != previousScan) {
-      // insert as a new score
-      scores_.at(lastWrittenIdx++).swap(scores_.at(idx));
-      previousScan = currentScan;
-      previousExpMass = currentExpMass;
-    } else {
-      PSMDescription::deletePtr(scores_.at(idx).pPSM);
+  for (size_t idx = 0u; idx < numPsms; ++idx) {
+    if (representative[idx] == idx) {
+      if (scores_[idx].isTarget()) {
+        ++totalNumberOfTargets_;
+      } else {
+        ++totalNumberOfDecoys_;
+      }
+      scores_[lastWrittenIdx++] = scores_[idx];
     }
   }
   scores_.resize(lastWrittenIdx);
-  */
-  postMergeStep();
+  postSelectionStep();
 }
 
 void Scores::recalculateDescriptionOfCorrect(const double fdr) {
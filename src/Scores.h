@@ -71,38 +71,6 @@ class ScoreHolder {
 inline bool operator>(const ScoreHolder& one, const ScoreHolder& other);
 inline bool operator<(const ScoreHolder& one, const ScoreHolder& other);
   
-struct lexicOrderProb : public binary_function<ScoreHolder, ScoreHolder, bool> {
-  static int compStrIt(std::string::iterator first1, std::string::iterator last1,
-                       std::string::iterator first2, std::string::iterator last2) {
-    for ( ; (first1 != last1) && (first2 != last2); first1++, first2++ ) {
-      if (*first1 < *first2) return 1;
-      if (*first2 < *first1) return -1;
-    }
-    if (first2 != last2) return 1;
-    else if (first1 != last1) return -1;
-    else return 0;
-  }
-  
-  bool operator()(const ScoreHolder& __x, const ScoreHolder& __y) const {
-    int peptCmp = compStrIt(__x.pPSM->getFullPeptideSequence().begin() + 2, 
-                            __x.pPSM->getFullPeptideSequence().end() - 2, 
-                            __y.pPSM->getFullPeptideSequence().begin() + 2, 
-                            __y.pPSM->getFullPeptideSequence().end() - 2);
-    return ( ( peptCmp == 1 ) 
-    || ( (peptCmp == 0) && (__x.label > __y.label) )
-    || ( (peptCmp == 0) && (__x.label == __y.label) && (__x.score > __y.score) ) );
-  }
-};
-
-struct OrderScanMassCharge : public binary_function<ScoreHolder, ScoreHolder, bool> {
-  bool operator()(const ScoreHolder& __x, const ScoreHolder& __y) const {
-    return ( (__x.pPSM->scan < __y.pPSM->scan ) 
-    || ( (__x.pPSM->scan == __y.pPSM->scan) && (__x.pPSM->expMass < __y.pPSM->expMass) )
-    || ( (__x.pPSM->scan == __y.pPSM->scan) && (__x.pPSM->expMass == __y.pPSM->expMass) 
-       && (__x.score > __y.score) ) );
-  }
-};
-
 struct UniqueScanMassCharge : public binary_function<ScoreHolder, ScoreHolder, bool> {
   bool operator()(const ScoreHolder& __x, const ScoreHolder& __y) const {
     return (__x.pPSM->scan == __y.pPSM->scan) && (__x.pPSM->expMass == __y.pPSM->expMass);
@@ -143,6 +111,7 @@ class Scores {
   ~Scores() {}
   void merge(vector<Scores>& sv, double fdr);
   void postMergeStep();
+  void postSelectionStep();
   
   std::vector<ScoreHolder>::iterator begin() { return scores_.begin(); }
   std::vector<ScoreHolder>::iterator end() { return scores_.end(); }
@@ -195,9 +164,8 @@ class Scores {
     scores_.push_back(sh);
   }
   
-  std::vector<PSMDescription*>& getPsms(PSMDescription* pPSM) {
-    return peptidePsmMap_[pPSM];
-  }
+  typedef std::vector<PSMDescription*>::const_iterator PsmIterator;
+  std::pair<PsmIterator, PsmIterator> getPsms(PSMDescription* pPSM) const;
   
   void reset() { 
     scores_.clear(); 
@@ -213,12 +181,23 @@ class Scores {
   int totalNumberOfDecoys_, totalNumberOfTargets_;
   
   std::vector<ScoreHolder> scores_;
-  std::map<PSMDescription*, std::vector<PSMDescription*> > peptidePsmMap_;
+  
+  // peptide -> PSMs in compressed sparse row form, filled by weedOutRedundant:
+  // the PSMs of peptide i are peptidePsms_[peptidePsmOffsets_[i]] up to
+  // peptidePsms_[peptidePsmOffsets_[i+1]], peptideIndex_ maps the
+  // representative PSM of each peptide to i and is sorted on the pointer
+  std::vector<PSMDescription*> peptidePsms_;
+  std::vector<size_t> peptidePsmOffsets_;
+  std::vector<std::pair<PSMDescription*, size_t> > peptideIndex_;
   DescriptionOfCorrect doc_;
   
   double* decoyPtr_;
   double* targetPtr_;
   
+  void sortIfNeeded();
+  void findGroupRepresentatives(const std::vector<uint64_t>& hashes,
+    bool (*sameKey)(const ScoreHolder&, const ScoreHolder&),
+    std::vector<size_t>& representative) const;
   void reorderFeatureRows(FeatureMemoryPool& featurePool, bool isTarget,
     std::map<double*, double*>& movedAddresses, size_t& idx);
   void checkSeparationAndSetPi0();
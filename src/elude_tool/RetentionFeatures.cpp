@@ -57,6 +57,36 @@ const string RetentionFeatures::kGroupNames[] = {"No posttranslationally modifie
 /* whenever a modified peptide is not identified, use the unmodified instead? */
 bool RetentionFeatures::ignore_ptms_ = false;
 
+namespace {
+  /* get the amino acid at the N-terminus of a peptide (including its modification) */
+  string GetNTermAA(const string &peptide) {
+    int end_position;
+    string aa, next_aa;
+
+    aa = peptide.at(0);
+    next_aa = peptide.at(1);
+    if (next_aa == "[") {
+      end_position = peptide.find("]", 0);
+      aa = peptide.substr(0, end_position + 1);
+    }
+    return aa;
+  }
+
+  /* get the amino acid at the C-terminus of a peptide (including its modification) */
+  string GetCTermAA(const string &peptide) {
+    int start_position, len = peptide.size();
+    string aa;
+
+    if (peptide.at(len - 1) == ']') {
+      start_position = peptide.find_last_of("[", len - 1);
+      aa = peptide.substr(start_position - 1);
+    } else {
+      aa = peptide.at(len - 1);
+    }
+    return aa;
+  }
+}
+
 RetentionFeatures::RetentionFeatures() {
   string aa_alphabet[] = {"A", "C", "D", "E", "F", "G", "H", "I", "K", "L", "M", "N", "P", "Q", "R", "S", "T", "V", "W", "Y"};
   amino_acids_alphabet_.assign(aa_alphabet, aa_alphabet + 20);
@@ -301,30 +331,12 @@ double RetentionFeatures::IndexAvg(const string &peptide, const map<string, doub
  */
 /* calculate the hydrophobicity of the N-terminus */
 double RetentionFeatures::IndexN(const string &peptide, const map<string, double> &index) {
-  int end_position, len = peptide.size();
-  string aa, next_aa;
-
-  aa = peptide.at(0);
-  next_aa = peptide.at(1);
-  if (next_aa == "[") {
-    end_position = peptide.find("]", 0);
-    aa = peptide.substr(0, end_position + 1);
-  }
-  return GetIndexValue(aa, index);
+  return GetIndexValue(GetNTermAA(peptide), index);
 }
 
 /* calculate the hydrophobicity of the C-terminus */
 double RetentionFeatures::IndexC(const string &peptide, const map<string, double> &index) {
-  int start_position, len = peptide.size();
-  string aa;
-
-  if (peptide.at(len - 1) == ']') {
-    start_position = peptide.find_last_of("[", len - 1);
-    aa = peptide.substr(start_position - 1);
-  } else {
-    aa = peptide.at(len - 1);
-  }
-  return GetIndexValue(aa, index);
+  return GetIndexValue(GetCTermAA(peptide), index);
 }
 
 /* calculate the sum of hydrophobicities of neighbours of polar amino acids */
@@ -621,6 +633,42 @@ double* RetentionFeatures::FillAAFeatures(const string &peptide, double *retenti
   return retention_features + amino_acids_alphabet_.size();
 }
 
+/* get the position in the alphabet that FillAAFeatures counts each residue at; -1 if the
+ * residue is not counted */
+vector<int> RetentionFeatures::GetAlphabetColumns(const vector<string> &residues) const {
+  int number_aa = amino_acids_alphabet_.size();
+  vector<int> columns(residues.size(), -1);
+
+  for(size_t k = 0; k < residues.size(); ++k) {
+    const string &aa = residues[k];
+    for(int i = 0; i < number_aa; ++i) {
+      if (amino_acids_alphabet_[i] == aa) {
+        columns[k] = i;
+        break;
+      }
+    }
+    if (columns[k] < 0 && ignore_ptms_) {
+      if (VERB >= 4) {
+        cerr << "Unable to find " << aa << " in the alphabet. We use "
+             << aa[0] << " instead. " << endl;
+      }
+      for(int i = 0; i < number_aa; ++i) {
+        if (amino_acids_alphabet_[i] == aa.substr(0,1)) {
+          columns[k] = i;
+          break;
+        }
+      }
+      if (columns[k] < 0) {
+        if (VERB >= 2) {
+          cerr << "Unable to find " << aa << " and " << aa[0]
+               << "in the alphabet. " << endl;
+        }
+      }
+    }
+  }
+  return columns;
+}
+
 /**************************** LENGTH FEATURES **************************************/
 /* compute the features related to length; */
 double* RetentionFeatures::ComputeLengthFeatures(const string &peptide, double *features) {
@@ -679,39 +727,343 @@ double* RetentionFeatures::ComputePhosFeatures(const string &peptide, double *fe
   return features;
 }
 
+/************* RETENTION FEATURES FOR A BATCH OF PEPTIDES **************/
+namespace {
+  /* number of peptides a thread takes at a time when computing the features of a batch */
+  const int kPeptidesPerChunk = 64;
+
+  /* The residues of a batch of peptides, each distinct residue (modified or not) coded as a
+   * small integer the first time it is seen. The codes of the peptides are stored back to
+   * back, peptide k taking [offsets[k], offsets[k + 1]) */
+  struct ResidueCodes {
+    /* residue of every code */
+    vector<string> residues;
+    vector<int> codes;
+    vector<size_t> offsets;
+    /* codes of the terminal residues, as read by IndexN and IndexC */
+    vector<int> n_term, c_term;
+    map<string, int> code_of;
+
+    ResidueCodes() : offsets(1, 0u) {}
+
+    int GetCode(const string &aa) {
+      map<string, int>::const_iterator it = code_of.find(aa);
+      if (it != code_of.end()) {
+        return it->second;
+      }
+      int code = residues.size();
+      code_of.insert(make_pair(aa, code));
+      residues.push_back(aa);
+      return code;
+    }
+
+    void AddPeptide(const string &peptide, const bool termini) {
+      vector<string> amino_acids = RetentionFeatures::GetAminoAcids(peptide);
+      vector<string>::const_iterator it = amino_acids.begin();
+      for( ; it != amino_acids.end(); ++it) {
+        codes.push_back(GetCode(*it));
+      }
+      offsets.push_back(codes.size());
+      if (termini) {
+        n_term.push_back(GetCode(GetNTermAA(peptide)));
+        c_term.push_back(GetCode(GetCTermAA(peptide)));
+      }
+    }
+
+    const int* Peptide(const size_t k) const {
+      return codes.empty() ? NULL : &codes[0] + offsets[k];
+    }
+    int PeptideLength(const size_t k) const {
+      return offsets[k + 1] - offsets[k];
+    }
+  };
+
+  /* An index resolved for the residue codes of a batch: the value of every code (the errors and
+   * the fallback to the unmodified aa are the ones of GetIndexValue), whether it is one of the
+   * polar or hydrophobic aa of the index, and the average value of the index */
+  struct CompiledIndex {
+    vector<double> value;
+    vector<char> polar, hydrophobic;
+    double avg;
+
+    void Compile(const vector<string> &residues, const map<string, double> &index) {
+      pair< set<string>, set<string> > extreme_aa = RetentionFeatures::GetExtremeRetentionAA(index);
+      size_t num_codes = residues.size();
+      value.resize(num_codes);
+      polar.resize(num_codes);
+      hydrophobic.resize(num_codes);
+      for(size_t code = 0; code < num_codes; ++code) {
+        value[code] = RetentionFeatures::GetIndexValue(residues[code], index);
+        polar[code] = extreme_aa.first.count(residues[code]) > 0;
+        hydrophobic[code] = extreme_aa.second.count(residues[code]) > 0;
+      }
+      avg = RetentionFeatures::AvgHydrophobicityIndex(index);
+    }
+  };
+
+  /* cos(i * angle) and sin(i * angle) for the positions i of the hydrophobic moments */
+  struct MomentAngle {
+    vector<double> cos_i, sin_i;
+
+    MomentAngle(const double &angle_degrees, const int &max_position) {
+      double angle_radians = angle_degrees * M_PI / 180;
+      for(int i = 0; i <= max_position; ++i) {
+        cos_i.push_back(cos(i * angle_radians));
+        sin_i.push_back(sin(i * angle_radians));
+      }
+    }
+  };
+
+  /* the most and least hydrophobic windows; same as IndexMaxPartialSum and IndexMinPartialSum */
+  void PartialSums(const double *h, const int len, const int win, double &max_sum,
+                   double &min_sum) {
+    int window_size = min(win, len - 1);
+    double sum = 0.0;
+    int lead = 0;
+
+    for( ; lead < window_size; ++lead) {
+      sum += h[lead];
+    }
+    max_sum = min_sum = sum;
+    for(int lag = 0; lead < len; ++lead, ++lag) {
+      sum -= h[lag];
+      sum += h[lead];
+      max_sum = max(max_sum, sum);
+      min_sum = min(min_sum, sum);
+    }
+  }
+
+  /* the most and least hydrophobic sides of alpha helices; same as IndexMaxHydrophobicSideHelix
+   * and IndexMinHydrophobicSideHelix */
+  void SidesHelix(const double *h, const int len, const double avg, double &max_side,
+                  double &min_side) {
+    double cos300 = cos(300 * M_PI / 180);
+    double cos400 = cos(400 * M_PI / 180);
+
+    if (len < 9) {
+      max_side = min_side = avg * (1 + 2 * cos300 + 2 * cos400);
+      return;
+    }
+    max_side = min_side = h[4] + cos300 * (h[1] + h[7]) + cos400 * (h[0] + h[8]);
+    for(int i = 5; i <= len - 5; ++i) {
+      double side = h[i] + cos300 * (h[i - 3] + h[i + 3]) + cos400 * (h[i - 4] + h[i + 4]);
+      max_side = max(max_side, side);
+      min_side = min(min_side, side);
+    }
+  }
+
+  /* the maximum and minimum hydrophobic moments; same as IndexMaxHydrophobicMoment and
+   * IndexMinHydrophobicMoment */
+  void HydrophobicMoments(const double *h, const int len, const double avg,
+                          const MomentAngle &angle, const int win, double &max_hmoment,
+                          double &min_hmoment) {
+    double sin_sum = 0.0, cos_sum = 0.0;
+
+    if (len < win) {
+      for(int i = 1; i <= win; ++i) {
+        cos_sum += angle.cos_i[i];
+        sin_sum += angle.sin_i[i];
+      }
+      cos_sum *= avg;
+      sin_sum *= avg;
+      max_hmoment = min_hmoment = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+      return;
+    }
+    int lead = 0, i = 1;
+    for( ; lead < win; ++lead, ++i) {
+      cos_sum += h[lead] * angle.cos_i[i];
+      sin_sum += h[lead] * angle.sin_i[i];
+    }
+    max_hmoment = min_hmoment = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+    for(int lag = 0; lead < len; ++lead, ++lag, ++i) {
+      cos_sum += h[lead] * angle.cos_i[i];
+      cos_sum -= h[lag] * angle.cos_i[i - win];
+      sin_sum += h[lead] * angle.sin_i[i];
+      sin_sum -= h[lag] * angle.sin_i[i - win];
+      double window_hmoment = sqrt((cos_sum * cos_sum) + (sin_sum * sin_sum));
+      max_hmoment = max(max_hmoment, window_hmoment);
+      min_hmoment = min(min_hmoment, window_hmoment);
+    }
+  }
+
+  /* number of aa of a type, and of consecutive pairs of them; same as NumberTypeAA and
+   * NumberConsecTypeAA */
+  void CountTypeAA(const int *aa, const int len, const vector<char> &type, double &occurences,
+                   double &consec_occurences) {
+    occurences = consec_occurences = 0.0;
+    for(int i = 0; i < len; ++i) {
+      if (type[aa[i]]) {
+        ++occurences;
+        if (i < len - 1 && type[aa[i + 1]]) {
+          ++consec_occurences;
+        }
+      }
+    }
+  }
+
+  /* the same features as ComputeIndexFeatures, for a coded peptide; hydrophobicities is
+   * scratch space of at least len values */
+  double* ComputeCodedIndexFeatures(const int *aa, const int len, const int n_term,
+      const int c_term, const CompiledIndex &index, const MomentAngle &angle100,
+      const MomentAngle &angle180, double *hydrophobicities, double *features) {
+    double *h = hydrophobicities;
+    double sum = 0.0, max_value, min_value, max_value2, min_value2;
+
+    for(int i = 0; i < len; ++i) {
+      h[i] = index.value[aa[i]];
+      sum += h[i];
+    }
+    *(features++) = sum;
+    *(features++) = sum / (double) len;
+    *(features++) = index.value[n_term];
+    *(features++) = index.value[c_term];
+
+    double neighbours_sum = 0.0;
+    for(int i = 0; i < len; ++i) {
+      if (index.polar[aa[i]]) {
+        if (i > 0) {
+          neighbours_sum += max(0.0, h[i - 1]);
+        }
+        if (i < len - 1) {
+          neighbours_sum += max(0.0, h[i + 1]);
+        }
+      }
+    }
+    *(features++) = neighbours_sum;
+
+    PartialSums(h, len, 5, max_value, min_value);
+    PartialSums(h, len, 2, max_value2, min_value2);
+    *(features++) = max_value;
+    *(features++) = max_value2;
+    *(features++) = min_value;
+    *(features++) = min_value2;
+
+    SidesHelix(h, len, index.avg, max_value, min_value);
+    *(features++) = max_value;
+    *(features++) = min_value;
+
+    HydrophobicMoments(h, len, index.avg, angle100, 11, max_value, min_value);
+    HydrophobicMoments(h, len, index.avg, angle180, 11, max_value2, min_value2);
+    *(features++) = max_value;
+    *(features++) = max_value2;
+    *(features++) = min_value;
+    *(features++) = min_value2;
+
+    double squared_diff_sum = 0.0, diff;
+    for(int i = 1; i < len; ++i) {
+      diff = h[i - 1] - h[i];
+      squared_diff_sum += diff * diff;
+    }
+    *(features++) = squared_diff_sum;
+
+    CountTypeAA(aa, len, index.polar, max_value, min_value);
+    *(features++) = max_value;
+    *(features++) = min_value;
+    CountTypeAA(aa, len, index.hydrophobic, max_value, min_value);
+    *(features++) = max_value;
+    *(features++) = min_value;
+
+    return features;
+  }
+
+  /* the same features as FillAAFeatures, for a coded peptide */
+  double* FillCodedAAFeatures(const int *aa, const int len, const vector<int> &columns,
+                              const int number_aa, double *features) {
+    for(int i = 0; i < number_aa; ++i) {
+      features[i] = 0.0;
+    }
+    for(int i = 0; i < len; ++i) {
+      if (columns[aa[i]] >= 0) {
+        ++features[columns[aa[i]]];
+      }
+    }
+    return features + number_aa;
+  }
+}
+
 /************* RETENTION FEATURES FOR PSMS **************/
 /* computes the retention features for a set of peptides; return 0 if success */
 int RetentionFeatures::ComputeRetentionFeatures(vector<PSMDescription*> &psms) {
-  vector<PSMDescription*>::iterator it= psms.begin();
-  for( ; it != psms.end(); ++it) {
-    ComputeRetentionFeatures(*it);
+  bool no_ptms = active_feature_groups_.test(INDEX_NO_PTMS_GROUP);
+  bool phos = active_feature_groups_.test(INDEX_PHOS_GROUP);
+  bool aa_only = active_feature_groups_.test(AA_GROUP);
+  int num_peptides = psms.size();
+
+  // the residues are coded and all the lookups that can fail are done here, so that
+  // nothing is thrown from the parallel loop below
+  ResidueCodes residue_codes;
+  vector<double*> psm_features(num_peptides);
+  int max_length = 0;
+  for(int k = 0; k < num_peptides; ++k) {
+    psm_features[k] = psms[k]->getRetentionFeatures();
+    // if there is no memory allocated
+    if (psm_features[k] == NULL) {
+      ostringstream temp;
+      temp << "Error: Memory not allocated for the retention features. Execution aborted." << endl;
+      throw MyException(temp.str());
+    }
+    string peptide = psms[k]->getFullPeptideSequence();
+    string::size_type pos1 = peptide.find('.');
+    string::size_type pos2 = peptide.find('.', ++pos1);
+    residue_codes.AddPeptide(peptide.substr(pos1, pos2 - pos1), no_ptms || phos);
+    max_length = max(max_length, residue_codes.PeptideLength(k));
+  }
+
+  CompiledIndex kyte_doolittle, svr, bulkiness;
+  if (no_ptms) {
+    kyte_doolittle.Compile(residue_codes.residues, kKyteDoolittle);
+  }
+  if (no_ptms || phos) {
+    svr.Compile(residue_codes.residues, svr_index_);
+  }
+  if (no_ptms) {
+    bulkiness.Compile(residue_codes.residues, kBulkiness);
+  }
+  vector<int> columns;
+  if (no_ptms || phos || aa_only) {
+    columns = GetAlphabetColumns(residue_codes.residues);
+  }
+  int number_aa = amino_acids_alphabet_.size();
+  MomentAngle angle100(100, max(max_length, 11)), angle180(180, max(max_length, 11));
+
+#pragma omp parallel
+  {
+    vector<double> hydrophobicities(max(max_length, 1));
+#pragma omp for schedule(dynamic, kPeptidesPerChunk)
+    for(int k = 0; k < num_peptides; ++k) {
+      const int *aa = residue_codes.Peptide(k);
+      int len = residue_codes.PeptideLength(k);
+      double *features = psm_features[k];
+      if (no_ptms) {
+        features = ComputeCodedIndexFeatures(aa, len, residue_codes.n_term[k],
+            residue_codes.c_term[k], kyte_doolittle, angle100, angle180,
+            &hydrophobicities[0], features);
+        features = ComputeCodedIndexFeatures(aa, len, residue_codes.n_term[k],
+            residue_codes.c_term[k], svr, angle100, angle180, &hydrophobicities[0], features);
+        double bulkiness_sum = 0.0;
+        for(int i = 0; i < len; ++i) {
+          bulkiness_sum += bulkiness.value[aa[i]];
+        }
+        *(features++) = bulkiness_sum;
+        *(features++) = len;
+        features = FillCodedAAFeatures(aa, len, columns, number_aa, features);
+      }
+      if (phos) {
+        features = ComputeCodedIndexFeatures(aa, len, residue_codes.n_term[k],
+            residue_codes.c_term[k], svr, angle100, angle180, &hydrophobicities[0], features);
+        *(features++) = len;
+        features = FillCodedAAFeatures(aa, len, columns, number_aa, features);
+      }
+      if (aa_only) {
+        features = FillCodedAAFeatures(aa, len, columns, number_aa, features);
+      }
+    }
   }
   return 0; //NOTE why returns value if its not used?
 }
 
 /* computes the retention features for one psm */
 int RetentionFeatures::ComputeRetentionFeatures(PSMDescription* psm) {
-  string peptide = psm->getFullPeptideSequence();
-  string::size_type pos1 = peptide.find('.');
-  string::size_type pos2 = peptide.find('.', ++pos1);
-  string pep = peptide.substr(pos1, pos2 - pos1);
-  double* features = psm->getRetentionFeatures();
-
-  // if there is memory allocated
-  if (features != NULL) {
-    if (active_feature_groups_.test(INDEX_NO_PTMS_GROUP)) {
-      features = ComputeNoPTMFeatures(pep, features);
-    }
-    if (active_feature_groups_.test(INDEX_PHOS_GROUP)) {
-      features = ComputePhosFeatures(pep, features);
-    }
-    if (active_feature_groups_.test(AA_GROUP)) {
-      features = FillAAFeatures(pep, features);
-    }
-  } else {
-    ostringstream temp;
-    temp << "Error: Memory not allocated for the retention features. Execution aborted." << endl;
-    throw MyException(temp.str());
-  }
-  return 0;
+  vector<PSMDescription*> psms(1, psm);
+  return ComputeRetentionFeatures(psms);
 }
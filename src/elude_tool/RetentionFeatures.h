@@ -165,7 +165,8 @@ class RetentionFeatures {
    double* ComputePhosFeatures(const std::string &peptide, double *features);
 
    /************* RETENTION FEATURES FOR PSMS **************/
-   /* computes the retention features for a set of peptides; return 0 if success */
+   /* computes the retention features for a set of peptides in parallel, coding the
+    * residues of all peptides as small integers once; return 0 if success */
    int ComputeRetentionFeatures(std::vector<PSMDescription*> &psms);
    /* computes the retention features for one psm */
    int ComputeRetentionFeatures(PSMDescription* psm);
@@ -198,6 +199,10 @@ class RetentionFeatures {
    std::map<std::string, double> svr_index_;
    /* amino acids alphabet (can include post translationally modified peptides) */
    std::vector<std::string> amino_acids_alphabet_;
+
+   /* get the position in the alphabet that FillAAFeatures counts each residue at; -1 if
+    * the residue is not counted */
+   std::vector<int> GetAlphabetColumns(const std::vector<std::string> &residues) const;
 };
 
 #endif /* ELUDE_RETENTIONFEATURES_H_ */
@@ -23,6 +23,8 @@
 
 #include "RetentionFeatures.h"
 #include "PSMDescription.h"
+#include "PSMDescriptionDOC.h"
+#include "MyException.h"
 #include "Globals.h"
 
 class RetentionFeaturesTest: public ::testing::Test {
@@ -36,6 +38,47 @@ class RetentionFeaturesTest: public ::testing::Test {
     }
 
     RetentionFeatures rf;
+
+    /* compute the features of the peptides in one batch, and again one peptide at a time with
+     * the functions of the feature groups; every feature of the two must be the same */
+    void ExpectBatchEqualsPerPeptide(const vector<string> &peptides) {
+      int n_features = rf.GetTotalNumberFeatures();
+      int n_peptides = peptides.size();
+      vector<double> batch_features(n_peptides * n_features, -1.0);
+      vector<PSMDescriptionDOC> psms;
+      for (int k = 0; k < n_peptides; ++k) {
+        psms.push_back(PSMDescriptionDOC(peptides[k], 0.0));
+      }
+      vector<PSMDescription*> psm_pointers;
+      for (int k = 0; k < n_peptides; ++k) {
+        psms[k].setRetentionFeatures(&batch_features[k * n_features]);
+        psm_pointers.push_back(&psms[k]);
+      }
+      rf.ComputeRetentionFeatures(psm_pointers);
+
+      bitset<RetentionFeatures::NUM_FEATURE_GROUPS> groups = rf.active_feature_groups();
+      vector<double> features(n_features, -1.0);
+      for (int k = 0; k < n_peptides; ++k) {
+        string::size_type pos1 = peptides[k].find('.');
+        string::size_type pos2 = peptides[k].find('.', ++pos1);
+        string peptide = peptides[k].substr(pos1, pos2 - pos1);
+        double *end = &features[0];
+        if (groups.test(RetentionFeatures::INDEX_NO_PTMS_GROUP)) {
+          end = rf.ComputeNoPTMFeatures(peptide, end);
+        }
+        if (groups.test(RetentionFeatures::INDEX_PHOS_GROUP)) {
+          end = rf.ComputePhosFeatures(peptide, end);
+        }
+        if (groups.test(RetentionFeatures::AA_GROUP)) {
+          end = rf.FillAAFeatures(peptide, end);
+        }
+        ASSERT_EQ(n_features, end - &features[0]);
+        for (int i = 0; i < n_features; ++i) {
+          EXPECT_DOUBLE_EQ(features[i], batch_features[k * n_features + i])
+              << "the batch gives a different feature " << i << " for \"" << peptides[k] << "\"";
+        }
+      }
+    }
 };
 
 TEST_F(RetentionFeaturesTest, TestGetIndexValue)
@@ -600,36 +643,87 @@ TEST_F(RetentionFeaturesTest, TestComputeNoPTMFeatures)
 TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesNoPtms)
 {
   rf.set_svr_index(RetentionFeatures::k_kyte_doolittle());
-  PSMDescription psm1("AAAA[unimod:21]", 10.0);
-  PSMDescription psm2("R.YY[unimod:21]YY.R", 11.0);
+  PSMDescriptionDOC psm1("AAAA[unimod:21]", 10.0);
+  PSMDescriptionDOC psm2("R.YY[unimod:21]YY.R", 11.0);
   int n_features = rf.GetTotalNumberFeatures();
-  psm1.getRetentionFeatures() = new double[n_features];
-  psm2.getRetentionFeatures() = new double[n_features];
-  vector<PSMDescription> psms;
-  psms.push_back(psm1);
-  psms.push_back(psm2);
+  vector<double> features1(n_features), features2(n_features);
+  psm1.setRetentionFeatures(&features1[0]);
+  psm2.setRetentionFeatures(&features2[0]);
+  vector<PSMDescription*> psms;
+  psms.push_back(&psm1);
+  psms.push_back(&psm2);
 
   rf.ComputeRetentionFeatures(psms);
   for (int i = 0; i < n_features; ++i) {
     if (i == 0) {
-      EXPECT_NEAR(RetentionFeatures::IndexSum(psm1.peptide, RetentionFeatures::k_kyte_doolittle()), psms[0].getRetentionFeatures()[i], 0.01) << " i = 0";
-      EXPECT_NEAR(RetentionFeatures::IndexSum(psm2.peptide.substr(2,15), RetentionFeatures::k_kyte_doolittle()), psms[1].getRetentionFeatures()[i], 0.01)  << " i = 0";
+      EXPECT_NEAR(RetentionFeatures::IndexSum(psm1.peptide, RetentionFeatures::k_kyte_doolittle()), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 0";
+      EXPECT_NEAR(RetentionFeatures::IndexSum(psm2.peptide.substr(2,15), RetentionFeatures::k_kyte_doolittle()), psms[1]->getRetentionFeatures()[i], 0.01)  << " i = 0";
     } if (i == 39) {
       set<string> hydrophobic_aa = RetentionFeatures::GetExtremeRetentionAA(RetentionFeatures::k_kyte_doolittle()).second;
-      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm1.peptide, hydrophobic_aa), psms[0].getRetentionFeatures()[i], 0.01)  << " i = 39";
-      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm2.peptide.substr(2,15), hydrophobic_aa), psms[1].getRetentionFeatures()[i], 0.01) << " i = 39";
+      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm1.peptide, hydrophobic_aa), psms[0]->getRetentionFeatures()[i], 0.01)  << " i = 39";
+      EXPECT_NEAR(RetentionFeatures::NumberConsecTypeAA(psm2.peptide.substr(2,15), hydrophobic_aa), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 39";
     }if (i == 40) {
-      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm1.peptide, RetentionFeatures::k_bulkiness()), psms[0].getRetentionFeatures()[i], 0.01) << " i = 40";
-      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm2.peptide.substr(2,15), RetentionFeatures::k_bulkiness()), psms[1].getRetentionFeatures()[i], 0.01) << " i = 40";
+      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm1.peptide, RetentionFeatures::k_bulkiness()), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 40";
+      EXPECT_NEAR(RetentionFeatures::ComputeBulkinessSum(psm2.peptide.substr(2,15), RetentionFeatures::k_bulkiness()), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 40";
     }if (i == 41) {
-      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm1.peptide), psms[0].getRetentionFeatures()[i], 0.01) << " i = 41";
-      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm2.peptide.substr(2,15)), psms[1].getRetentionFeatures()[i], 0.01) << " i = 41";
+      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm1.peptide), psms[0]->getRetentionFeatures()[i], 0.01) << " i = 41";
+      EXPECT_NEAR(RetentionFeatures::PeptideLength(psm2.peptide.substr(2,15)), psms[1]->getRetentionFeatures()[i], 0.01) << " i = 41";
     }if (i == 42) {
-      EXPECT_NEAR(4.0, psms[0].getRetentionFeatures()[i], 0.01) << " i = 42";
-      EXPECT_FLOAT_EQ(0, psms[1].getRetentionFeatures()[i]) << " i = 42";
+      EXPECT_NEAR(4.0, psms[0]->getRetentionFeatures()[i], 0.01) << " i = 42";
+      EXPECT_FLOAT_EQ(0, psms[1]->getRetentionFeatures()[i]) << " i = 42";
     }if (i == 61) {
-      EXPECT_NEAR(4.0, psms[1].getRetentionFeatures()[i], 0.01) << " i = 61";
-      EXPECT_FLOAT_EQ(0, psms[0].getRetentionFeatures()[i]) << " i = 61";
+      EXPECT_NEAR(4.0, psms[1]->getRetentionFeatures()[i], 0.01) << " i = 61";
+      EXPECT_FLOAT_EQ(0, psms[0]->getRetentionFeatures()[i]) << " i = 61";
     }
   }
 }
+
+TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesBatchIgnorePtms)
+{
+  // S[unimod:21] is in the index and the alphabet, M[unimod:35] in neither, so it is
+  // replaced by M
+  map<string, double> idx = RetentionFeatures::k_kyte_doolittle();
+  idx["S[unimod:21]"] = -2.5;
+  rf.set_svr_index(idx);
+  vector<string> alphabet = rf.amino_acids_alphabet();
+  alphabet.push_back("S[unimod:21]");
+  rf.set_amino_acids_alphabet(alphabet);
+  rf.set_active_feature_groups(bitset<RetentionFeatures::NUM_FEATURE_GROUPS>("111"));
+
+  string temp[] = { "K.AS[unimod:21]MM[unimod:35]PEK.R", "-.LLLVVIIFFDEEKGGS[unimod:21]R.-",
+      "R.M[unimod:35]YS[unimod:21]LK.A", "PEPTIDE", "K.WK.A", "K.AS[unimod:21]MM[unimod:35]PEK.R",
+      "R.M[unimod:35]K.-", "K.DDDDDDDDDDDDK.L" };
+  ExpectBatchEqualsPerPeptide(vector<string>(temp, temp + 8));
+}
+
+TEST_F(RetentionFeaturesTest, TestComputeRetentionFeaturesBatchWithPtms)
+{
+  // when the ptms are not ignored, M[unimod:35] is not counted by the aa features
+  rf.set_ignore_ptms(false);
+  map<string, double> idx = RetentionFeatures::k_kyte_doolittle();
+  idx["S[unimod:21]"] = -2.5;
+  idx["M[unimod:35]"] = 0.7;
+  rf.set_svr_index(idx);
+  vector<string> alphabet = rf.amino_acids_alphabet();
+  alphabet.push_back("S[unimod:21]");
+  rf.set_amino_acids_alphabet(alphabet);
+  bitset<RetentionFeatures::NUM_FEATURE_GROUPS> groups;
+  groups.set(RetentionFeatures::INDEX_PHOS_GROUP);
+  groups.set(RetentionFeatures::AA_GROUP);
+  rf.set_active_feature_groups(groups);
+
+  string temp[] = { "K.AS[unimod:21]MM[unimod:35]PEK.R", "R.M[unimod:35]YS[unimod:21]LK.A",
+      "-.LLLVVIIFFDEEKGGS[unimod:21]R.-", "K.WK.A" };
+  ExpectBatchEqualsPerPeptide(vector<string>(temp, temp + 4));
+
+  // the kyte doolittle index has no modified aa, so both fail for the no ptms group
+  groups.set(RetentionFeatures::INDEX_NO_PTMS_GROUP);
+  rf.set_active_feature_groups(groups);
+  PSMDescriptionDOC psm("K.AS[unimod:21]K.R", 0.0);
+  vector<double> features(rf.GetTotalNumberFeatures());
+  psm.setRetentionFeatures(&features[0]);
+  vector<PSMDescription*> psms(1, &psm);
+  EXPECT_THROW(rf.ComputeRetentionFeatures(psms), MyException);
+  EXPECT_THROW(rf.ComputeNoPTMFeatures("AS[unimod:21]K", &features[0]), MyException);
+  rf.set_ignore_ptms(true);
+}
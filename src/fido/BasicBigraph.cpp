@@ -17,7 +17,10 @@ void BasicBigraph::read(Scores* fullset, bool multiple_labeled_peptides) {
   string pepName, protName;
   double value =  -10;
   int pepIndex = -1;
-  StringTable PSMNames, proteinNames;
+  // size the tables to the input, the default size makes lookups linear in
+  // the number of peptides for large data sets
+  StringTable PSMNames(fullset->size() + 1), proteinNames(fullset->size() + 1);
+  vector<pair<int, int> > edges;
 
   vector<ScoreHolder>::iterator psm = fullset->begin();
   for (; psm!= fullset->end(); ++psm) {
@@ -52,7 +55,7 @@ void BasicBigraph::read(Scores* fullset, bool multiple_labeled_peptides) {
       if (proteinNames.lookup(protName) == -1) {
         add(proteinsToPSMs, proteinNames, protName);
       }
-      connect(PSMNames, pepName, proteinNames, protName);
+      edges.push_back(make_pair(pepIndex, proteinNames.lookup(protName)));
     }
     // p probability of the peptide match to the spectrum
     value = 1 - psm->pep;
@@ -61,6 +64,7 @@ void BasicBigraph::read(Scores* fullset, bool multiple_labeled_peptides) {
 
   PSMsToProteins.names = PSMNames.getItemsByNumber();
   proteinsToPSMs.names = proteinNames.getItemsByNumber();
+  CompressedBigraph(PSMsToProteins.size(), proteinsToPSMs.size(), edges).swap(graph);
   
   //NOTE this function is assigning PeptideThreshold probablity to all the PSMs with a prob below PeptideThreshold
   /**pseudoCountPSMs();**/
@@ -76,6 +80,7 @@ void BasicBigraph::read(istream & is, bool multiple_labeled_peptides) {
   int state = 'e';
 
   StringTable PSMNames, proteinNames;
+  vector<pair<int, int> > edges;
 
   while (is >> instr) {
     if (instr == 'e' && (state == 'e' || state == 'p')) {
@@ -104,7 +109,7 @@ void BasicBigraph::read(istream & is, bool multiple_labeled_peptides) {
       if ( proteinNames.lookup(protName) == -1 )
         add(proteinsToPSMs, proteinNames, protName);
 
-      connect(PSMNames, pepName, proteinNames, protName);
+      edges.push_back(make_pair(pepIndex, proteinNames.lookup(protName)));
       state = 'p';
     } else if ( instr == 'p' && state == 'p' ) {
       is >> value;
@@ -122,6 +127,7 @@ void BasicBigraph::read(istream & is, bool multiple_labeled_peptides) {
 
   PSMsToProteins.names = PSMNames.getItemsByNumber();
   proteinsToPSMs.names = proteinNames.getItemsByNumber();
+  CompressedBigraph(PSMsToProteins.size(), proteinsToPSMs.size(), edges).swap(graph);
 
   //NOTE this function is assigning PeptideThreshold probablity to all the PSMs with a prob below PeptideThreshold
   /**pseudoCountPSMs();**/
@@ -132,208 +138,133 @@ void BasicBigraph::printGraphStats() const
   cout << "There are \t" << PSMsToProteins.size() << " PSMs" << endl;
   cout << "      and \t" << proteinsToPSMs.size() << " proteins" << endl;
 
-  int edgeCount = 0;
-  for (int k=0; k<PSMsToProteins.size(); k++)
-    {
-      edgeCount += PSMsToProteins.associations[k].size();
-    }
-
-  cout << "      and \t" << edgeCount << " edges" << endl;
+  cout << "      and \t" << graph.numEdges() << " edges" << endl;
 }
 
 
-void BasicBigraph::saveSeveredProteins() {
+void BasicBigraph::prune() {
+  // remove PSMs below PsmThreshold and proteins for which none of the 
+  // remaining PSMs reaches ProteinThreshold
+  vector<bool> keepPSMs(graph.numPSMs()), keepProteins(graph.numProteins());
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    keepPSMs[k] = !(PSMsToProteins.weights[k] < PsmThreshold);
+  }
+  
   severedProteins = Array<string>();
-  for (int k = 0; k < proteinsToPSMs.size(); k++) {
-    if (proteinsToPSMs.associations[k].size() == 0) {
+  for (int k = 0; k < graph.numProteins(); k++) {
+    bool connected = false;
+    double best = -Numerical::inf();
+    for (int j = 0; j < graph.proteinDegree(k); j++) {
+      int psm = graph.psmOfProtein(k, j);
+      if (keepPSMs[psm]) {
+        connected = true;
+        best = max(best, PSMsToProteins.weights[psm]);
+      }
+    }
+    keepProteins[k] = connected && !(best < ProteinThreshold);
+    if (!keepProteins[k]) {
       severedProteins.add( proteinsToPSMs.names[k] );
     }
   }
-}
-
-void BasicBigraph::prune() {
-  removePoorPSMs();
-  removePoorProteins();
-  saveSeveredProteins();
-  reindex();
-  markSectionPartitions();
+  
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    bool connected = false;
+    for (int j = 0; j < graph.psmDegree(k) && !connected; j++) {
+      connected = keepProteins[ graph.proteinOfPSM(k, j) ];
+    }
+    keepPSMs[k] = keepPSMs[k] && connected;
+  }
+  reindex(keepPSMs, keepProteins);
+  
   cloneMultipleMarkedPSMs();
-  reindex();
 }
 
-
 void BasicBigraph::cloneMultipleMarkedPSMs() {
+  vector<bool> multipleSections;
+  markSectionPartitions(multipleSections);
+  
+  // the way the marking procedure works, it will only multiple mark PSMs 
+  // with a score <= PeptideThreshold. Such PSMs are replaced by a clone for 
+  // every section they are connected to, appended after the existing PSMs
   numberClones = 0;
-  // compute this once, since it will change as you add clones
-  int N = PSMsToProteins.size();
-
+  int N = graph.numPSMs();
+  vector<pair<int, int> > edges;
   for (int k = 0; k < N; k++) {
-    const GraphNode & psm = PSMsToProteins[k];
-    // the way the marking procedure works, it will only multiple
-    // mark PSMs with a score <= PeptideThreshold
-    if (psm.sectionMark.size() > 1) {
-      clonePSM(k);
+    if (!multipleSections[k]) {
+      for (int j = 0; j < graph.psmDegree(k); j++) {
+        edges.push_back(make_pair(k, graph.proteinOfPSM(k, j)));
+      }
+      continue;
     }
-  }
-}
-
-void BasicBigraph::clonePSM(int pepIndex) {
-  // add a new copy of this PSM for every section
-  // first find the sections that this PSM associates with
-  Set sections;
-  const Set & s = PSMsToProteins.associations[pepIndex];
-  for (int k = 0; k < s.size(); k++) {
-    int sect = proteinsToPSMs[ s[k] ].section;
-    sections |= Set::SingletonSet(sect);
-  }
-  // index the proteins by the sections they belong to
-  Array<Set> associatedProteinsBySection(sections.size());
-  for (int k = 0; k < s.size(); k++) {
-    int sect = proteinsToPSMs.sections[ s[k] ];
-    int ind = sections.find(sect);
-    associatedProteinsBySection[ ind ] |= Set::SingletonSet(s[k]);
-  }
-  // add a clone for each of the sections-- include the first one,
-  // since it will be easier to build them all than to have a special
-  // case. 
-
-  for (int k = 0; k < associatedProteinsBySection.size(); k++) {
-    int sect = sections[k];
-    ostringstream ost;
-    ost << PSMsToProteins[ pepIndex ].name << "_clone_" << sect;
     
-    PSMsToProteins.names.add( ost.str() );
-    PSMsToProteins.associations.add( associatedProteinsBySection[k] );
-    PSMsToProteins.weights.add( PSMsToProteins[ pepIndex ].weight );
-    PSMsToProteins.sections.add(sect);
-
-    // add the association from this section's proteins to the new peptide
-    for (int j = 0; j<associatedProteinsBySection[k].size(); j++)
-      proteinsToPSMs.associations[ associatedProteinsBySection[k][j] ] |= Set::SingletonSet( PSMsToProteins.size()-1 );
-  }
-
-  // afterward, erase the original
-  // (remove the associations from proteins)
-  for (int k = 0; k < associatedProteinsBySection.size(); k++) {
-    for (int j = 0; j < associatedProteinsBySection[k].size(); j++) {
-      int prot = associatedProteinsBySection[k][j];
-      proteinsToPSMs[prot].association = proteinsToPSMs[prot].association.without( Set::SingletonSet(pepIndex) );
+    vector<pair<int, int> > proteinsBySection;
+    for (int j = 0; j < graph.psmDegree(k); j++) {
+      int protein = graph.proteinOfPSM(k, j);
+      proteinsBySection.push_back(make_pair(proteinsToPSMs.sections[protein], protein));
     }
-  }
-
-  // (remove the associations to proteins)
-  PSMsToProteins[ pepIndex ].association = Set();
-  numberClones += sections.size()-1;
-}
-
-void BasicBigraph::reindex() {
-  int k;
-
-  // note: later check to see if you can do such that in Array using a
-  // pointer to a member function
-  Set connectedPSMs;
-  for (k = 0; k < PSMsToProteins.size(); k++) {
-    if (!PSMsToProteins.associations[k].isEmpty())
-      connectedPSMs.add(k);
-  }
-
-  Set connectedProteins;
-  for (k = 0; k < proteinsToPSMs.size(); k++) {
-    if (!proteinsToPSMs.associations[k].isEmpty())
-      connectedProteins.add(k);
-  }
-
-  // note: ahh! this is bad design. You need to remake this code
-  int backupNumberClones = numberClones;
-  Array<string> backupSeveredProteins = severedProteins;
-  double backupPeptideThreshold = PeptideThreshold;
-
-  *this = buildSubgraph(connectedProteins, connectedPSMs);
-  numberClones = backupNumberClones;
-  severedProteins = backupSeveredProteins;
-  PeptideThreshold = backupPeptideThreshold;
-}
-
-BasicBigraph BasicBigraph::buildSubgraph(const Set & connectedProteins, const Set & connectedPSMs) {
-  BasicBigraph result;
-
-  result.PSMsToProteins.names = PSMsToProteins.names[ connectedPSMs ];
-  result.PSMsToProteins.associations = PSMsToProteins.associations[ connectedPSMs ];
-  result.PSMsToProteins.weights = PSMsToProteins.weights[ connectedPSMs ];
-  result.PSMsToProteins.sections = PSMsToProteins.sections[ connectedPSMs ];
-
-  for (int k = 0; k < result.PSMsToProteins.associations.size(); k++) {
-    result.PSMsToProteins.associations[k] = result.PSMsToProteins.associations[k].reindexToFind( connectedProteins );
-  }
-
-  result.proteinsToPSMs.names = proteinsToPSMs.names[ connectedProteins ];
-  result.proteinsToPSMs.associations = proteinsToPSMs.associations[ connectedProteins ];
-  result.proteinsToPSMs.weights = proteinsToPSMs.weights[ connectedProteins ];
-  result.proteinsToPSMs.sections = proteinsToPSMs.sections[ connectedProteins ];
-
-  for (int k = 0; k < result.proteinsToPSMs.associations.size(); k++) {
-    result.proteinsToPSMs.associations[k] = result.proteinsToPSMs.associations[k].reindexToFind( connectedPSMs );
-  }
-
-  return result;
-}
-
-void BasicBigraph::removePoorPSMs() {
-  for (int k = 0; k < PSMsToProteins.size(); k++) {
-    if (PSMsToProteins.weights[k] < PsmThreshold) {
-      disconnectPSM(k);
+    sort(proteinsBySection.begin(), proteinsBySection.end());
+    
+    int numSections = 0;
+    for (size_t j = 0; j < proteinsBySection.size(); j++) {
+      int sect = proteinsBySection[j].first;
+      if (j == 0 || sect != proteinsBySection[j-1].first) {
+        ostringstream ost;
+        ost << PSMsToProteins.names[k] << "_clone_" << sect;
+        PSMsToProteins.names.add( ost.str() );
+        PSMsToProteins.weights.add( PSMsToProteins.weights[k] );
+        PSMsToProteins.sections.add(sect);
+        numSections++;
+      }
+      edges.push_back(make_pair(PSMsToProteins.names.size() - 1, proteinsBySection[j].second));
     }
+    numberClones += numSections - 1;
   }
-}
-
-void BasicBigraph::removePoorProteins() {
-  for (int k = 0; k < proteinsToPSMs.size(); k++) {
-    if (Vector(PSMsToProteins.weights[ proteinsToPSMs.associations[k] ]).max() < ProteinThreshold) {
-      disconnectProtein(k);
-    }
+  
+  if (PSMsToProteins.names.size() == N) return;
+  
+  // the cloned PSMs themselves are left without edges and removed
+  CompressedBigraph(PSMsToProteins.names.size(), graph.numProteins(), edges).swap(graph);
+  vector<bool> keepPSMs(graph.numPSMs()), keepProteins(graph.numProteins(), true);
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    keepPSMs[k] = graph.psmDegree(k) > 0;
   }
+  reindex(keepPSMs, keepProteins);
 }
 
-void BasicBigraph::disconnectPSM(int k) {
-  Set& as = PSMsToProteins.associations[k];
-  for (Set::Iterator iter = as.begin(); iter != as.end(); iter++) {
-    Set& setRef = proteinsToPSMs.associations[ *iter ];
-    setRef = setRef.without( Set::SingletonSet( k ) );
-  }
-  as = Set();
+// keeps the marked nodes and the edges between them, renumbering the nodes
+// of both layers in their original order
+void BasicBigraph::reindex(const vector<bool> & keepPSMs, 
+                           const vector<bool> & keepProteins) {
+  graph.subgraph(keepPSMs, keepProteins).swap(graph);
+  subsetLayer(PSMsToProteins, keepPSMs);
+  subsetLayer(proteinsToPSMs, keepProteins);
 }
 
-void BasicBigraph::disconnectProtein(int k) {
-  Set & as = proteinsToPSMs.associations[k];
-  for (Set::Iterator iter = as.begin(); iter != as.end(); iter++) {
-    Set & setRef = PSMsToProteins.associations[ *iter ];
-    setRef = setRef.without( Set::SingletonSet( k ) );
+void BasicBigraph::subsetLayer(GraphLayer & gl, const vector<bool> & keep) {
+  Array<string> names;
+  Array<double> weights;
+  Array<int> sections;
+  for (size_t k = 0; k < keep.size(); k++) {
+    if (keep[k]) {
+      names.add(gl.names[k]);
+      weights.add(gl.weights[k]);
+      sections.add(gl.sections[k]);
+    }
   }
-  as = Set();
+  gl.names = names;
+  gl.weights = weights;
+  gl.sections = sections;
 }
 
 void BasicBigraph::add(GraphLayer & gl, StringTable & st, const string & item) {
   if ( st.lookup(item) == -1 ) {
     // if the string is not already known, then add a new node for it
     st.add(item);
-    gl.associations.add( Set() );
     gl.weights.add( -1.0 );
     gl.sections.add(-1);
   }
 }
 
-void BasicBigraph::connect(const StringTable & pepNames, const string & pepName, const StringTable & proteinNames, const string & protName)
-{
-  int pepIndex = pepNames.lookup(pepName);
-  int protIndex = proteinNames.lookup(protName);
-
-  // performance note: currently O(n^2) worstcase. Later use a bitset
-  // and then after the graph is read, pack it into a set. 
-
-  PSMsToProteins.associations[ pepIndex ] |= Set::SingletonSet(protIndex);
-  proteinsToPSMs.associations[ protIndex ] |= Set::SingletonSet(pepIndex);
-}
-
 void BasicBigraph::printProteinWeights() const
 {
   const Array<string> & protNames = proteinsToPSMs.names;
@@ -346,82 +277,48 @@ void BasicBigraph::printProteinWeights() const
     }
 }
 
-void BasicBigraph::traceConnected(int index, GraphLayer & gl, int sectionNumber) {
-  if ( gl.sections[index] == sectionNumber )
-    return;
-  
-  // if it has not already been marked by this section, do so
-  gl.sections[index] = sectionNumber;
-  // add mark to set of marks for this node, set can only be larger than 1 for 
-  // peptides below PeptideThreshold
-  gl.sectionMarks[index] |= Set::SingletonSet(sectionNumber);
+int BasicBigraph::markSectionPartitions(vector<bool> & multipleSections) {
+  // returns the number of sections that are found
+  vector<int> proteinSections, psmSections;
+  vector<double> psmWeights = PSMsToProteins.weights.getVector();
+  int numSections = graph.markSections(psmWeights, PeptideThreshold, 
+      proteinSections, psmSections, multipleSections);
   
-  // do not follow edges with PSM probability below PeptideThreshold
-  if (&gl == &PSMsToProteins && gl.weights[index] <= PeptideThreshold)
-    return;
-
-  const Set& as = gl.associations[index];
-  for (Set::Iterator iter = as.begin(); iter != as.end(); iter++) {
-    if ( &gl == &proteinsToPSMs )
-      traceConnected(*iter, PSMsToProteins, sectionNumber);
-    else
-      traceConnected(*iter, proteinsToPSMs, sectionNumber);
-  }
+  PSMsToProteins.sections = Array<int>(psmSections);
+  proteinsToPSMs.sections = Array<int>(proteinSections);
+  return numSections;
 }
 
-int BasicBigraph::markSectionPartitions() {
-  // returns the number of sections that are found
-  proteinsToPSMs.sectionMarks = Array<Set>(proteinsToPSMs.size());
-  PSMsToProteins.sectionMarks = Array<Set>(PSMsToProteins.size());
-
-  PSMsToProteins.sections = Array<int>(PSMsToProteins.size(), -1);
-  proteinsToPSMs.sections = Array<int>(proteinsToPSMs.size(), -1);
-  
-  // MT: make sure proteins with equal peptide evidence end up in the same section
-  Array<Set> groups = ReplicateIndexer<Set>::replicates(Set::sumSetElements, proteinsToPSMs.associations );
-  std::map<int, int> mapToFirstInGroup;
+Array<BasicBigraph> BasicBigraph::partitionSections() {
+  vector<bool> multipleSections;
+  int numSections = markSectionPartitions(multipleSections);
   
-  for (int k = 0; k < groups.size(); k++) {
-    Set reps = groups[k].without( Set::SingletonSet(groups[k][0]) );
-    for (Set::Iterator iter = reps.begin(); iter != reps.end(); iter++) {
-      mapToFirstInGroup[*iter] = groups[k][0];
-    }
+  // renumber the nodes within their sections and distribute the edges
+  vector<int> numPSMs(numSections, 0), numProteins(numSections, 0);
+  vector<int> psmIndex(graph.numPSMs()), proteinIndex(graph.numProteins());
+  Array<BasicBigraph> result(numSections);
+  for (int k = 0; k < graph.numProteins(); k++) {
+    int sect = proteinsToPSMs.sections[k];
+    proteinIndex[k] = numProteins[sect]++;
+    result[sect].proteinsToPSMs.names.add(proteinsToPSMs.names[k]);
+    result[sect].proteinsToPSMs.weights.add(proteinsToPSMs.weights[k]);
+    result[sect].proteinsToPSMs.sections.add(sect);
   }
   
-  int section = 0;
-  for (int k = 0; k < proteinsToPSMs.size(); k++) {
-    if (mapToFirstInGroup.find(k) != mapToFirstInGroup.end()) {
-      int sectionNumber = proteinsToPSMs.sections[mapToFirstInGroup[k]];
-      proteinsToPSMs.sections[k] = sectionNumber;
-      // add mark to set of marks for this node, set can only be larger than 1 for 
-      // peptides below PeptideThreshold
-      proteinsToPSMs.sectionMarks[k] |= Set::SingletonSet(sectionNumber);
-    } else if (proteinsToPSMs[k].section == -1) {
-      traceConnected(k, proteinsToPSMs, section);
-      section++;
+  vector<vector<pair<int, int> > > edges(numSections);
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    int sect = PSMsToProteins.sections[k];
+    psmIndex[k] = numPSMs[sect]++;
+    result[sect].PSMsToProteins.names.add(PSMsToProteins.names[k]);
+    result[sect].PSMsToProteins.weights.add(PSMsToProteins.weights[k]);
+    result[sect].PSMsToProteins.sections.add(sect);
+    for (int j = 0; j < graph.psmDegree(k); j++) {
+      edges[sect].push_back(make_pair(psmIndex[k], proteinIndex[ graph.proteinOfPSM(k, j) ]));
     }
   }
-
-  return section;
-}
-
-Array<BasicBigraph> BasicBigraph::partitionSections() {
-  int numSections = markSectionPartitions();
-
-  Array<Set> proteinSubsets(numSections), PSMSubsets(numSections);
-  for (int k = 0; k < proteinsToPSMs.size(); k++) {
-    proteinSubsets[ proteinsToPSMs[k].section ].add(k);
-  }
-
-  for (int k = 0; k < PSMsToProteins.size(); k++) {
-    PSMSubsets[ PSMsToProteins[k].section ].add(k);
-  }
-
-  // now reindex them to their proper sets
-
-  Array<BasicBigraph> result;
+  
   for (int k = 0; k < numSections; k++) {
-    result.add( buildSubgraph( proteinSubsets[k], PSMSubsets[k] ) );
+    CompressedBigraph(numPSMs[k], numProteins[k], edges[k]).swap(result[k].graph);
   }
 
   return result;
@@ -7,24 +7,7 @@
 #include "Array.h"
 #include "Vector.h"
 #include "ReplicateIndexer.h"
-
-/*
-* GraphNode represents a PSM or protein with associated probability and
-* keeps a list of nodes it is connected to in the bigraph
-*
-*/
-struct GraphNode {
-  const string & name;
-  Set & association;
-  double & weight;
-  int & section;
-  Set & sectionMark;
-
-  GraphNode(const string & n, Set & a, double & w, int & s, Set & sM):
-    name(n), association(a), weight(w), section(s), sectionMark(sM) { }
-    
-  ~GraphNode() { }
-};
+#include "CompressedBigraph.h"
 
 /*
 * GraphLayer represents a collection of PSMs or proteins
@@ -32,24 +15,18 @@ struct GraphNode {
 */
 struct GraphLayer {
   Array<string> names;
-  Array<Set> associations;
   Array<double> weights;
   Array<int> sections;
-  Array<Set> sectionMarks;
 
   ~GraphLayer() { }
     
   friend ostream & operator <<(ostream & os, const GraphLayer & gl) {
-    os << "\t" << gl.associations << endl << "\t" << gl.weights << endl << "\t" << gl.names << endl;
+    os << "\t" << gl.weights << endl << "\t" << gl.names << endl;
     return os;
   }
   
-  GraphNode operator [] (int k) {
-    return GraphNode( names[k], associations[k], weights[k], sections[k], sectionMarks[k]);
-  }
-  
   int size() const {
-    return associations.size();
+    return names.size();
   }
 };
 
@@ -89,24 +66,15 @@ class BasicBigraph {
 protected:
   
   void add(GraphLayer & gl, StringTable & st, const string & item);
-  void connect(const StringTable & PSMNames, const string & pepStr, 
-	       const StringTable & proteinNames, const string & protStr);
-  void disconnectProtein(int k);
-  void disconnectPSM(int k);
   void pseudoCountPSMs();
   void floorLowPSMs();
-  int markSectionPartitions();
   void removeDegeneratePSMs();
   void cloneDegeneratePSMs();
-  void removePoorPSMs();
-  void removePoorProteins();
-  void reindex();
-  void cloneMultipleMarkedPSMs();
-  void clonePSM(int pepIndex);
-  void saveSeveredProteins();
   
-  BasicBigraph buildSubgraph(const Set & connectedProteins, const Set & connectedPSMs);
-  void traceConnected(int index, GraphLayer & gl, int sectionNumber);
+  void reindex(const vector<bool> & keepPSMs, const vector<bool> & keepProteins);
+  static void subsetLayer(GraphLayer & gl, const vector<bool> & keep);
+  int markSectionPartitions(vector<bool> & multipleSections);
+  void cloneMultipleMarkedPSMs();
 
   double PsmThreshold;
   double PeptideThreshold;
@@ -117,6 +85,8 @@ public:
   int numberClones;
   Array<string> severedProteins;
   GraphLayer proteinsToPSMs, PSMsToProteins;
+  // the edges between the two layers, indexed like the layers
+  CompressedBigraph graph;
   
 };
 
@@ -3,16 +3,22 @@
 
 #include "BasicGroupBigraph.h"
 
+const double BasicGroupBigraph::kBeliefPropagationTolerance = 1e-9;
+const double BasicGroupBigraph::kBeliefPropagationDamping = 0.5;
+const double BasicGroupBigraph::kLogWeightHeadroom = 64.0;
+
 BasicGroupBigraph::BasicGroupBigraph(double peptidePrior, bool noClustering, bool trivialGrouping) :
     logLikelihoodConstantCachedFunctor(
       &BasicGroupBigraph::logLikelihoodConstant, "logLikelihoodConstant"),
-    PeptidePrior(peptidePrior), noClustering_(noClustering), trivialGrouping_(trivialGrouping) {}
+    PeptidePrior(peptidePrior), noClustering_(noClustering), trivialGrouping_(trivialGrouping),
+    approximate_(false), acyclic_(false) {}
 
 BasicGroupBigraph::BasicGroupBigraph(double peptidePrior, const BasicBigraph & rhs, 
     bool noClustering, bool trivialGrouping) :
       BasicBigraph(rhs), logLikelihoodConstantCachedFunctor(
         &BasicGroupBigraph::logLikelihoodConstant, "logLikelihoodConstant"),
-      PeptidePrior(peptidePrior), noClustering_(noClustering), trivialGrouping_(trivialGrouping) {
+      PeptidePrior(peptidePrior), noClustering_(noClustering), trivialGrouping_(trivialGrouping),
+      approximate_(false), acyclic_(false) {
   if (noClustering_) trivialGroupProteins();
   else groupProteins();
 }
@@ -37,15 +43,18 @@ void BasicGroupBigraph::trivialGroupProteins() {
     groupProtNames[k] = Array<string>(1, proteinsToPSMs.names[k]);
     originalN[k] = Counter(1);
   }
+  findTreeSchedule();
 }
 
-void BasicGroupBigraph::groupProteinsBy(const Array<Set> & groups) {
+void BasicGroupBigraph::groupProteinsBy(const vector<vector<int> > & groups) {
   // remake the list of names and then remake the graph with them collapsed
   groupProtNames = Array<Array<string> > (groups.size());
   originalN = Array<Counter> (groups.size());
 
-  for (int k = 0; k < groups.size(); k++) {
-    groupProtNames[k] = proteinsToPSMs.names[ groups[k] ];
+  for (size_t k = 0; k < groups.size(); k++) {
+    for (size_t j = 0; j < groups[k].size(); j++) {
+      groupProtNames[k].add( proteinsToPSMs.names[ groups[k][j] ] );
+    }
     if (trivialGrouping_) { 
       // each group is either present or absent
       originalN[k] = Counter( 1 );
@@ -55,28 +64,95 @@ void BasicGroupBigraph::groupProteinsBy(const Array<Set> & groups) {
   }
 
   // remove all but the first of each group from the graph
-  for (int k = 0; k < groups.size(); k++) {
-    Set reps = groups[k].without( Set::SingletonSet(groups[k][0]) );
-    for (Set::Iterator iter = reps.begin(); iter != reps.end(); iter++) {
-      disconnectProtein(*iter);
+  vector<bool> keepPSMs(graph.numPSMs(), true), keepProteins(graph.numProteins(), false);
+  for (size_t k = 0; k < groups.size(); k++) {
+    keepProteins[ groups[k][0] ] = true;
+  }
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    bool connected = false;
+    for (int j = 0; j < graph.psmDegree(k) && !connected; j++) {
+      connected = keepProteins[ graph.proteinOfPSM(k, j) ];
     }
+    keepPSMs[k] = connected;
   }
 
-  reindex();
+  reindex(keepPSMs, keepProteins);
+  findTreeSchedule();
+}
+
+// Checks whether the graph of groups and peptides is a forest, in which case
+// the posteriors are computed exactly by belief propagation in linear time.
+// The schedule visits the peptides once from the leaves up, in reverse
+// breadth-first order, and once more from the roots down.
+void BasicGroupBigraph::findTreeSchedule() {
+  int numGroups = proteinsToPSMs.size();
+  int numPeptides = PSMsToProteins.size();
+  
+  // an edge within an already connected set of nodes closes a cycle
+  std::vector<int> sets(numGroups + numPeptides);
+  for (size_t k=0; k<sets.size(); k++)
+    sets[k] = k;
+  acyclic_ = true;
+  for (int k=0; k<numPeptides && acyclic_; k++) {
+    vector<int>::const_iterator groups = graph.proteinsOfPSM(k);
+    for (int j=0; j<graph.psmDegree(k) && acyclic_; j++) {
+      int a = groups[j], b = numGroups + k;
+      while (sets[a] != a) {
+        sets[a] = sets[ sets[a] ];
+        a = sets[a];
+      }
+      while (sets[b] != b) {
+        sets[b] = sets[ sets[b] ];
+        b = sets[b];
+      }
+      if (a == b) acyclic_ = false;
+      else sets[a] = b;
+    }
+  }
+  
+  treeSchedule_.clear();
+  if (!acyclic_) return;
+  
+  std::vector<bool> visitedGroups(numGroups, false), visitedPeptides(numPeptides, false);
+  std::vector<int> queue, order;
+  for (int root=0; root<numGroups; root++) {
+    if (visitedGroups[root]) continue;
+    visitedGroups[root] = true;
+    queue.assign(1, root);
+    for (size_t i=0; i<queue.size(); i++) {
+      vector<int>::const_iterator peptides = graph.psmsOfProtein(queue[i]);
+      for (int j=0; j<graph.proteinDegree(queue[i]); j++) {
+        int k = peptides[j];
+        if (visitedPeptides[k]) continue;
+        visitedPeptides[k] = true;
+        order.push_back(k);
+        vector<int>::const_iterator groups = graph.proteinsOfPSM(k);
+        for (int l=0; l<graph.psmDegree(k); l++) {
+          if (!visitedGroups[ groups[l] ]) {
+            visitedGroups[ groups[l] ] = true;
+            queue.push_back(groups[l]);
+          }
+        }
+      }
+    }
+  }
+  treeSchedule_.assign(order.rbegin(), order.rend());
+  treeSchedule_.insert(treeSchedule_.end(), order.begin(), order.end());
 }
 
 // uses hashing of PSMs associations set per protein to find proteins with the
 // same set of PSMs
 void BasicGroupBigraph::groupProteins() {
-  Array<Set> groups = ReplicateIndexer<Set>::replicates(Set::sumSetElements, proteinsToPSMs.associations );
-  groupProteinsBy(groups);
+  vector<vector<int> > replicates;
+  graph.proteinReplicates(replicates);
+  groupProteinsBy(replicates);
 }
 
 int BasicGroupBigraph::numberAssociatedProteins(int indexEpsilon) const {
   int tot = 0;
 
-  const Set & s = PSMsToProteins.associations[indexEpsilon];
-  for (int k=0; k<s.size(); k++) {
+  vector<int>::const_iterator s = graph.proteinsOfPSM(indexEpsilon);
+  for (int k=0; k<graph.psmDegree(indexEpsilon); k++) {
     tot += originalN[ s[k] ].size;
   }
   
@@ -86,8 +162,8 @@ int BasicGroupBigraph::numberAssociatedProteins(int indexEpsilon) const {
 int BasicGroupBigraph::numberActiveAssociatedProteins(int indexEpsilon, const Array<Counter> & n) const {
   int tot = 0;
 
-  const Set & s = PSMsToProteins.associations[indexEpsilon];
-  for (int k=0; k<s.size(); k++) {
+  vector<int>::const_iterator s = graph.proteinsOfPSM(indexEpsilon);
+  for (int k=0; k<graph.psmDegree(indexEpsilon); k++) {
     tot += n[ s[k] ].state;
   }
   
@@ -145,23 +221,162 @@ double BasicGroupBigraph::likelihoodNGivenD(const Model & m, const Array<Counter
   return prod;
 }
 
+double BasicGroupBigraph::logLikelihoodEEpsilonGivenActive(const Model & m, int indexEpsilon, int active) const {
+  double probEGivenD = PSMsToProteins.weights[indexEpsilon];
+  double probEGivenN = probabilityEEpsilonGivenActiveAssociatedProteins(m, active);
+  double probE = PeptidePrior;
+  double termE = probEGivenD / probE * probEGivenN;
+  double termNotE = (1-probEGivenD) / (1-probE) * (1-probEGivenN);
+  double term = termE + termNotE;
+  
+  return log2(term);
+}
+
 double BasicGroupBigraph::logLikelihoodNGivenD(const Model & m, const Array<Counter> & n) const {
   double logProd = 0.0;
 
   for (int k=0; k<PSMsToProteins.size(); k++) {
-    double probEGivenD = PSMsToProteins.weights[k];
-    double probEGivenN = probabilityEEpsilonGivenN(m, k, n);
-    double probE = PeptidePrior;
-    double termE = probEGivenD / probE * probEGivenN;
-    double termNotE = (1-probEGivenD) / (1-probE) * (1-probEGivenN);
-    double term = termE + termNotE;
-    
-    logProd += log2(term);
+    int active = numberActiveAssociatedProteins(k, n);
+    logProd += logLikelihoodEEpsilonGivenActive(m, k, active);
   }
 
   return logProd;
 }
 
+// Visits all configurations of the groups in Gray code order. Since a single
+// group changes its state in each step, only the terms of the peptides 
+// adjacent to that group are updated. Terms that are zero (log = -inf) are
+// counted separately so that they can be removed from the running sums again.
+// Returns the log likelihood constant and, if probR is given, fills it with 
+// the posterior probabilities of the groups, both in a single pass.
+double BasicGroupBigraph::enumerateConfigurations(const Model & m, Array<double>* probR) const {
+  Array<Counter> n = originalN;
+  int numGroups = n.size();
+  int numPeptides = PSMsToProteins.size();
+  
+  // the log terms of each peptide for every number of active associated 
+  // proteins, and of each group for every state, are tabulated up front so
+  // that the enumeration itself only does lookups
+  std::vector<int> peptideTableOffsets(numPeptides + 1, 0);
+  for (int k=0; k<numPeptides; k++) {
+    peptideTableOffsets[k+1] = peptideTableOffsets[k] + numberAssociatedProteins(k) + 1;
+  }
+  std::vector<double> peptideTermTable(peptideTableOffsets.back());
+  for (int k=0; k<numPeptides; k++) {
+    for (int a=peptideTableOffsets[k]; a<peptideTableOffsets[k+1]; a++) {
+      peptideTermTable[a] = logLikelihoodEEpsilonGivenActive(m, k, a - peptideTableOffsets[k]);
+    }
+  }
+  
+  std::vector<int> groupTableOffsets(numGroups + 1, 0);
+  for (int k=0; k<numGroups; k++) {
+    groupTableOffsets[k+1] = groupTableOffsets[k] + n[k].size + 1;
+  }
+  std::vector<double> groupTermTable(groupTableOffsets.back());
+  for (int k=0; k<numGroups; k++) {
+    for (int s=groupTableOffsets[k]; s<groupTableOffsets[k+1]; s++) {
+      groupTermTable[s] = log2(m.probabilityProteins(n[k].size, s - groupTableOffsets[k]));
+    }
+  }
+  
+  std::vector<int> active(numPeptides, 0);
+  std::vector<double> peptideTerms(numPeptides);
+  double logLike = 0.0;
+  int numZeroPeptideTerms = 0;
+  for (int k=0; k<numPeptides; k++) {
+    peptideTerms[k] = peptideTermTable[ peptideTableOffsets[k] ];
+    if (std::isinf(peptideTerms[k])) numZeroPeptideTerms++;
+    else logLike += peptideTerms[k];
+  }
+  
+  std::vector<double> groupTerms(numGroups);
+  double logProbN = 0.0;
+  int numZeroGroupTerms = 0;
+  for (int k=0; k<numGroups; k++) {
+    groupTerms[k] = groupTermTable[ groupTableOffsets[k] ];
+    if (std::isinf(groupTerms[k])) numZeroGroupTerms++;
+    else logProbN += groupTerms[k];
+  }
+  
+  // the configuration weights are summed relative to logReference, which is 
+  // only moved up once a term exceeds it by kLogWeightHeadroom. A group keeps
+  // its state while all faster digits cycle, so the weights are collected in
+  // a pending sum per digit and only credited to a group when its digit, or 
+  // a slower one, changes; each pending sum then moves to the next digit.
+  GrayCounter gc(n);
+  int numDigits = gc.numDigits();
+  std::vector<double> weightedStates(numGroups, 0.0);
+  std::vector<double> pendingWeights(numDigits + 1, 0.0);
+  double totalWeight = 0.0;
+  double logReference = -Numerical::inf();
+  bool starting = true;
+  
+  do {
+    if (!starting) {
+      int g = gc.changed();
+      if (probR != NULL) {
+        int changedDigit = gc.changedDigit();
+        for (int j=0; j<=changedDigit; j++) {
+          const Counter & c = n[ gc.digitCounter(j) ];
+          int state = (j == changedDigit) ? c.state - gc.delta() : c.state;
+          weightedStates[ gc.digitCounter(j) ] += pendingWeights[j] * state / c.size;
+          pendingWeights[j+1] += pendingWeights[j];
+          pendingWeights[j] = 0.0;
+        }
+      }
+      
+      vector<int>::const_iterator peptides = graph.psmsOfProtein(g);
+      for (int j=0; j<graph.proteinDegree(g); j++) {
+        int k = peptides[j];
+        active[k] += gc.delta();
+        double term = peptideTermTable[ peptideTableOffsets[k] + active[k] ];
+        if (std::isinf(peptideTerms[k])) numZeroPeptideTerms--;
+        else logLike -= peptideTerms[k];
+        if (std::isinf(term)) numZeroPeptideTerms++;
+        else logLike += term;
+        peptideTerms[k] = term;
+      }
+      
+      double term = groupTermTable[ groupTableOffsets[g] + n[g].state ];
+      if (std::isinf(groupTerms[g])) numZeroGroupTerms--;
+      else logProbN -= groupTerms[g];
+      if (std::isinf(term)) numZeroGroupTerms++;
+      else logProbN += term;
+      groupTerms[g] = term;
+    }
+    starting = false;
+    
+    if (numZeroPeptideTerms == 0 && numZeroGroupTerms == 0) {
+      double logLikeTerm = logLike + logProbN;
+      if (logLikeTerm > logReference + kLogWeightHeadroom) {
+        double scale = pow(2.0, logReference - logLikeTerm);
+        totalWeight *= scale;
+        for (int k=0; k<numGroups; k++) weightedStates[k] *= scale;
+        for (int j=0; j<numDigits; j++) pendingWeights[j] *= scale;
+        logReference = logLikeTerm;
+      }
+      double weight = pow(2.0, logLikeTerm - logReference);
+      totalWeight += weight;
+      pendingWeights[0] += weight;
+    }
+  } while (gc.advance());
+  
+  double result = logReference + log2(totalWeight);
+  
+  if (probR != NULL) {
+    for (int j=0; j<numDigits; j++) {
+      const Counter & c = n[ gc.digitCounter(j) ];
+      weightedStates[ gc.digitCounter(j) ] += pendingWeights[j] * c.state / c.size;
+      pendingWeights[j+1] += pendingWeights[j];
+    }
+    *probR = Array<double>(numGroups);
+    for (int k=0; k<numGroups; k++)
+      (*probR)[k] = weightedStates[k] / totalWeight;
+  }
+  
+  return result;
+}
+
 double BasicGroupBigraph::probabilityN(const Model & m, const Array<Counter> & n) const {
   double prod = 1.0;
 
@@ -193,25 +408,7 @@ double BasicGroupBigraph::probabilityNGivenD(const Model & m, const Array<Counte
 }
 
 double BasicGroupBigraph::logLikelihoodConstant(const Model & m) const {
-  double result = 0.0;
-  bool starting = true;
-
-  Array<Counter> n = originalN;
-
-  for (Counter::start(n); Counter::inRange(n); Counter::advance(n)) {
-    double L = logLikelihoodNGivenD(m, n);
-    double p = log2(probabilityN(m, n));
-    double logLikeTerm = L+p;
-
-    if ( starting ) {
-      starting = false;
-      result = logLikeTerm;
-    } else {
-      result = Numerical::logAdd(result, logLikeTerm);
-    }
-  }
-
-  return result;
+  return enumerateConfigurations(m, NULL);
 }
 
 double BasicGroupBigraph::likelihoodConstant(const Model & m) const {
@@ -266,24 +463,164 @@ double BasicGroupBigraph::eCorrectionEpsilon(int indexEpsilon, const Model & m,
   return termE / term;
 }
 
-Array<double> BasicGroupBigraph::probabilityRGivenD(const Model & m) {
-  Array<Counter> n = originalN;
-  Vector result;
-
-  for (Counter::start(n); Counter::inRange(n); Counter::advance(n)) {
-    Vector term = probabilityNGivenD(m, n) * Vector( probabilityRGivenN(n) );
+Array<double> BasicGroupBigraph::probabilityRGivenD(const Model & m) const {
+  if (approximate_) {
+    std::vector<int> sweep(PSMsToProteins.size());
+    for (int k=0; k<PSMsToProteins.size(); k++) 
+      sweep[k] = k;
+    return beliefPropagation(m, sweep, kMaxBeliefPropagationSweeps, kBeliefPropagationDamping);
+  }
+  if (acyclic_) {
+    return beliefPropagation(m, treeSchedule_, 1, 0.0);
+  }
+  
+  Array<double> result;
+  enumerateConfigurations(m, &result);
+  return result;
+}
 
-    if ( result.size() == 0 ) {
-      result = term;
-    } else {
-      result += term;
+// Computes the posterior probabilities of the groups with (loopy) belief
+// propagation on the same model. The term of a peptide only depends on the 
+// number of active associated proteins m and has the form A + B*(1-alpha)^m,
+// so the message from a peptide to a group follows from the expected values
+// of (1-alpha)^state of the other groups, in time linear in its degree. The
+// peptides are visited in the order of the schedule, updating the messages 
+// in place, until none of them changes anymore or maxSweeps is reached. The 
+// log messages into the states of each group are summed, with zero messages
+// counted separately as in enumerateConfigurations. On a tree, a single sweep
+// over the schedule of findTreeSchedule gives the exact posteriors.
+Array<double> BasicGroupBigraph::beliefPropagation(const Model & m, 
+    const std::vector<int> & schedule, int maxSweeps, double damping) const {
+  int numGroups = originalN.size();
+  int numPeptides = PSMsToProteins.size();
+  
+  std::vector<int> stateOffsets(numGroups + 1, 0);
+  int maxSize = 0;
+  for (int g=0; g<numGroups; g++) {
+    stateOffsets[g+1] = stateOffsets[g] + originalN[g].size + 1;
+    maxSize = max(maxSize, originalN[g].size);
+  }
+  std::vector<double> powers(maxSize + 1);
+  for (int s=0; s<=maxSize; s++) {
+    powers[s] = pow(1 - m.alpha, s);
+  }
+  
+  // the beliefs start from the priors of the groups
+  std::vector<double> logSums(stateOffsets.back(), 0.0);
+  std::vector<int> numZeros(stateOffsets.back(), 0);
+  for (int g=0; g<numGroups; g++) {
+    for (int s=0; s<=originalN[g].size; s++) {
+      double term = log2(m.probabilityProteins(originalN[g].size, s));
+      if (std::isinf(term)) numZeros[ stateOffsets[g] + s ]++;
+      else logSums[ stateOffsets[g] + s ] = term;
     }
   }
-
-  return result.unpack();
+  
+  // one message per peptide and associated group, starting uniform
+  std::vector<int> edgeOffsets(numPeptides + 1, 0), messageOffsets(1, 0);
+  for (int k=0; k<numPeptides; k++) {
+    vector<int>::const_iterator groups = graph.proteinsOfPSM(k);
+    for (int j=0; j<graph.psmDegree(k); j++) {
+      messageOffsets.push_back(messageOffsets.back() + originalN[ groups[j] ].size + 1);
+    }
+    edgeOffsets[k+1] = messageOffsets.size() - 1;
+  }
+  std::vector<double> messages(messageOffsets.back(), 0.0);
+  
+  std::vector<double> expectations, prefix, suffix, cavity;
+  for (int sweep=0; sweep<maxSweeps; sweep++) {
+    double maxChange = 0.0;
+    for (size_t i=0; i<schedule.size(); i++) {
+      int k = schedule[i];
+      int edge = edgeOffsets[k];
+      vector<int>::const_iterator groups = graph.proteinsOfPSM(k);
+      int degree = graph.psmDegree(k);
+      double probEGivenD = PSMsToProteins.weights[k];
+      double probE = PeptidePrior;
+      double termA = probEGivenD / probE;
+      double termB = (1 - m.beta) * ((1-probEGivenD) / (1-probE) - probEGivenD / probE);
+      
+      // expected (1-alpha)^state of each group without this peptide
+      expectations.assign(degree, 1.0);
+      for (int j=0; j<degree; j++) {
+        int g = groups[j];
+        const double* message = &messages[ messageOffsets[edge + j] ];
+        double logMax = -Numerical::inf();
+        cavity.resize(originalN[g].size + 1);
+        for (int s=0; s<=originalN[g].size; s++) {
+          int idx = stateOffsets[g] + s;
+          int zeros = numZeros[idx] - (std::isinf(message[s]) ? 1 : 0);
+          cavity[s] = zeros > 0 ? -Numerical::inf() : 
+              logSums[idx] - (std::isinf(message[s]) ? 0.0 : message[s]);
+          logMax = max(logMax, cavity[s]);
+        }
+        if (std::isinf(logMax)) continue;
+        double total = 0.0, weighted = 0.0;
+        for (int s=0; s<=originalN[g].size; s++) {
+          double q = pow(2.0, cavity[s] - logMax);
+          total += q;
+          weighted += q * powers[s];
+        }
+        expectations[j] = weighted / total;
+      }
+      prefix.assign(degree + 1, 1.0);
+      suffix.assign(degree + 1, 1.0);
+      for (int j=0; j<degree; j++) {
+        prefix[j+1] = prefix[j] * expectations[j];
+        suffix[degree-1-j] = suffix[degree-j] * expectations[degree-1-j];
+      }
+      
+      for (int j=0; j<degree; j++, edge++) {
+        int g = groups[j];
+        double* message = &messages[ messageOffsets[edge] ];
+        double others = prefix[j] * suffix[j+1];
+        
+        // the new message, scaled to a maximum of 1 and damped
+        cavity.resize(originalN[g].size + 1);
+        double largest = 0.0;
+        for (int s=0; s<=originalN[g].size; s++) {
+          cavity[s] = max(termA + termB * powers[s] * others, 0.0);
+          largest = max(largest, cavity[s]);
+        }
+        double scale = largest > 0.0 ? 1.0 / largest : 0.0;
+        for (int s=0; s<=originalN[g].size; s++) {
+          double previous = pow(2.0, message[s]);
+          double updated = (1 - damping) * cavity[s] * scale + damping * previous;
+          maxChange = max(maxChange, fabs(updated - previous));
+          
+          int idx = stateOffsets[g] + s;
+          if (std::isinf(message[s])) numZeros[idx]--;
+          else logSums[idx] -= message[s];
+          message[s] = log2(updated);
+          if (std::isinf(message[s])) numZeros[idx]++;
+          else logSums[idx] += message[s];
+        }
+      }
+    }
+    if (maxChange < kBeliefPropagationTolerance) break;
+  }
+  
+  Array<double> result(numGroups);
+  for (int g=0; g<numGroups; g++) {
+    double logMax = -Numerical::inf();
+    for (int s=0; s<=originalN[g].size; s++) {
+      int idx = stateOffsets[g] + s;
+      if (numZeros[idx] == 0) logMax = max(logMax, logSums[idx]);
+    }
+    double total = 0.0, expected = 0.0;
+    for (int s=0; s<=originalN[g].size && !std::isinf(logMax); s++) {
+      int idx = stateOffsets[g] + s;
+      double belief = numZeros[idx] == 0 ? pow(2.0, logSums[idx] - logMax) : 0.0;
+      total += belief;
+      expected += belief * s;
+    }
+    result[g] = total > 0.0 ? expected / total / originalN[g].size : 0.0;
+  }
+  
+  return result;
 }
 
-Array<double> BasicGroupBigraph::probabilityRGivenN(const Array<Counter> & n) {
+Array<double> BasicGroupBigraph::probabilityRGivenN(const Array<Counter> & n) const {
   Array<double> result(n.size());
 
   for (int k=0; k<result.size(); k++) {
@@ -293,7 +630,7 @@ Array<double> BasicGroupBigraph::probabilityRGivenN(const Array<Counter> & n) {
   return result;
 }
 
-double BasicGroupBigraph::probabilityRRhoGivenN(int indexRho, const Array<Counter> & n) {
+double BasicGroupBigraph::probabilityRRhoGivenN(int indexRho, const Array<Counter> & n) const {
   const Counter & c = n[indexRho];
 
   return double(c.state) / c.size;
@@ -303,6 +640,10 @@ void BasicGroupBigraph::getProteinProbs(const Model & m) {
   probabilityR = probabilityRGivenD(m);
 }
 
+void BasicGroupBigraph::getProteinProbs(const Model & m, Array<double> & probs) const {
+  probs = probabilityRGivenD(m);
+}
+
 double BasicGroupBigraph::probabilityEEpsilonOverAllAlphaBeta(const GridModel & gm, int indexEpsilon) const {
   GridModel localModel( gm );
 
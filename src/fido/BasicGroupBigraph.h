@@ -68,6 +68,70 @@ class Counter {
   }
 };
 
+/*
+* GrayCounter enumerates the states of an array of Counters in reflected 
+*   mixed-radix Gray code order, i.e. each step changes the state of a single
+*   Counter by +1 or -1 (Knuth, TAOCP 7.2.1.1, Algorithm H). Counters with 
+*   size 0 are left untouched.
+* 
+*/
+class GrayCounter {
+ public:
+  GrayCounter(Array<Counter> & cA) : cA_(cA) { start(); }
+  ~GrayCounter() {}
+  
+  void start() {
+    digits_.clear();
+    for (int k=0; k<cA_.size(); k++) {
+      cA_[k].start();
+      if (cA_[k].size > 0) digits_.push_back(k);
+    }
+    int numDigits = digits_.size();
+    direction_.assign(numDigits, 1);
+    focus_.resize(numDigits + 1);
+    for (int j=0; j<=numDigits; j++)
+      focus_[j] = j;
+    changed_ = -1;
+    changedDigit_ = -1;
+    delta_ = 0;
+  }
+  
+  // moves to the next configuration; returns false when all have been visited
+  bool advance() {
+    int numDigits = digits_.size();
+    int j = focus_[0];
+    focus_[0] = 0;
+    if (j == numDigits) return false;
+    
+    Counter & c = cA_[ digits_[j] ];
+    c.state += direction_[j];
+    changed_ = digits_[j];
+    changedDigit_ = j;
+    delta_ = direction_[j];
+    if (c.state == 0 || c.state == c.size) {
+      direction_[j] = -direction_[j];
+      focus_[j] = focus_[j+1];
+      focus_[j+1] = j+1;
+    }
+    return true;
+  }
+  
+  // index of the Counter changed by the last advance and its change in state
+  int changed() const { return changed_; }
+  int delta() const { return delta_; }
+  
+  // digits are the Counters with a nonzero size, fastest changing first; 
+  // digit j only changes once all digits below it have reached an end
+  int numDigits() const { return digits_.size(); }
+  int digitCounter(int j) const { return digits_[j]; }
+  int changedDigit() const { return changedDigit_; }
+
+ private:
+  Array<Counter> & cA_;
+  std::vector<int> digits_, direction_, focus_;
+  int changed_, changedDigit_, delta_;
+};
+
 /*
 * BasicGroupBigraph extends BasicBigraph by allowing proteins to be 
 *   grouped (=clustered). This brings the added complexity of multiple possible
@@ -96,6 +160,7 @@ class BasicGroupBigraph : public BasicBigraph {
   
   double logNumberOfConfigurations() const;
   void getProteinProbs(const Model& m);
+  void getProteinProbs(const Model& m, Array<double>& probs) const;
   void printProteinWeights() const;
 
   const Array<double>& proteinProbabilities() const { return probabilityR; }
@@ -106,8 +171,21 @@ class BasicGroupBigraph : public BasicBigraph {
   
   void setPeptidePrior(double peptide_prior);
   double getPeptidePrior();
+  
+  // use loopy belief propagation instead of enumerating all configurations
+  void setApproximate(bool b) { approximate_ = b; }
+  bool getApproximate() const { return approximate_; }
 
  private:  
+  /* maximum number of sweeps over the peptides in belief propagation */
+  const static int kMaxBeliefPropagationSweeps = 500;
+  /* belief propagation stops when no message changes by more than this */
+  const static double kBeliefPropagationTolerance;
+  /* weight of the previous message when updating a message */
+  const static double kBeliefPropagationDamping;
+  /* log2 of the largest configuration weight before the sums are rescaled */
+  const static double kLogWeightHeadroom;
+  
   Array<Counter> originalN;
   Array<Array<string> > groupProtNames;
   Array<double> probabilityR;
@@ -122,11 +200,16 @@ class BasicGroupBigraph : public BasicBigraph {
   double PeptidePrior;
   bool noClustering_;
   bool trivialGrouping_;
+  bool approximate_;
+  /* the groups and peptides form a forest, solved exactly along treeSchedule_ */
+  bool acyclic_;
+  std::vector<int> treeSchedule_;
  
   // protected construction functions
   void groupProteins();
   void trivialGroupProteins();
-  void groupProteinsBy(const Array<Set> & groups);
+  void groupProteinsBy(const vector<vector<int> > & groups);
+  void findTreeSchedule();
  
   // protected utility functions
   int numberAssociatedProteins(int indexEpsilon) const;
@@ -139,8 +222,12 @@ class BasicGroupBigraph : public BasicBigraph {
   double probabilityNumberAssociatedProteins(const Model& m, int total, int active) const;
   double probabilityEEpsilonGivenN(const Model& m, int indexEpsilon, const Array<Counter> & n) const;
 
+  double logLikelihoodEEpsilonGivenActive(const Model& m, int indexEpsilon, int active) const;
   double likelihoodNGivenD(const Model& m, const Array<Counter> & n) const;
   double logLikelihoodNGivenD(const Model& m, const Array<Counter> & n) const;
+  double enumerateConfigurations(const Model& m, Array<double>* probR) const;
+  Array<double> beliefPropagation(const Model& m, const std::vector<int> & schedule,
+                                  int maxSweeps, double damping) const;
 
   double probabilityN(const Model& m, const Array<Counter> & n) const;
   double probabilityNNu(const Model& m, const Counter & nNu) const;
@@ -149,9 +236,9 @@ class BasicGroupBigraph : public BasicBigraph {
   double logLikelihoodConstant(const Model& m) const;
   double likelihoodConstant(const Model& m) const;
 
-  Array<double> probabilityRGivenD(const Model& m);
-  Array<double> probabilityRGivenN(const Array<Counter> & n);
-  double probabilityRRhoGivenN(int indexRho, const Array<Counter> & n);
+  Array<double> probabilityRGivenD(const Model& m) const;
+  Array<double> probabilityRGivenN(const Array<Counter> & n) const;
+  double probabilityRRhoGivenN(int indexRho, const Array<Counter> & n) const;
 
   Array<double> probabilityEGivenD(const Model& m);
   Array<double> eCorrection(const Model& m, const Array<Counter> & n);
@@ -0,0 +1,123 @@
+// see license for more information
+
+#include "ComponentTree.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+  struct DescendingWeight {
+    const vector<double> & weights;
+    DescendingWeight(const vector<double> & w) : weights(w) {}
+    bool operator()(int a, int b) const { return weights[a] > weights[b]; }
+  };
+}
+
+ComponentTree::ComponentTree(const CompressedBigraph & graph,
+    const vector<double> & psmWeights, const vector<vector<int> > & groups,
+    double minWeight) : numLeaves_(groups.size()) {
+  vector<int> leafOfProtein(graph.numProteins(), -1);
+  for (int k = 0; k < numLeaves_; k++) {
+    for (size_t j = 0; j < groups[k].size(); j++) {
+      leafOfProtein[ groups[k][j] ] = k;
+    }
+    left_.push_back(-1);
+    right_.push_back(-1);
+    weight_.push_back(numeric_limits<double>::infinity());
+    minProtein_.push_back(groups[k][0]);
+  }
+
+  vector<int> psms;
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    if (psmWeights[k] > minWeight) psms.push_back(k);
+  }
+  stable_sort(psms.begin(), psms.end(), DescendingWeight(psmWeights));
+
+  // every union of two sets adds a node above the nodes of both sets; the
+  // sets are kept by the union-find forest, with the tree node of each root
+  vector<int> sets(numLeaves_), sizes(numLeaves_, 1), top(numLeaves_);
+  for (int k = 0; k < numLeaves_; k++) {
+    sets[k] = k;
+    top[k] = k;
+  }
+  for (size_t i = 0; i < psms.size(); i++) {
+    int psm = psms[i], first = -1;
+    for (int j = 0; j < graph.psmDegree(psm); j++) {
+      int leaf = leafOfProtein[ graph.proteinOfPSM(psm, j) ];
+      if (leaf == -1) continue;
+      if (first == -1) {
+        first = leaf;
+        continue;
+      }
+      int a = find(sets, first), b = find(sets, leaf);
+      if (a == b) continue;
+      if (sizes[a] < sizes[b]) swap(a, b);
+
+      int node = weight_.size();
+      left_.push_back(top[a]);
+      right_.push_back(top[b]);
+      weight_.push_back(psmWeights[psm]);
+      minProtein_.push_back(min(minProtein_[ top[a] ], minProtein_[ top[b] ]));
+      sets[b] = a;
+      sizes[a] += sizes[b];
+      top[a] = node;
+    }
+  }
+
+  // children are created before their parents, so the protein ranges can be
+  // laid out from the highest node down
+  int N = weight_.size();
+  parent_.assign(N, -1);
+  vector<int> counts(N, 0);
+  for (int k = 0; k < N; k++) {
+    if (isLeaf(k)) {
+      counts[k] = groups[k].size();
+    } else {
+      parent_[ left_[k] ] = parent_[ right_[k] ] = k;
+      counts[k] = counts[ left_[k] ] + counts[ right_[k] ];
+    }
+  }
+  begin_.assign(N, 0);
+  end_.assign(N, 0);
+  int offset = 0;
+  for (int k = N - 1; k >= 0; k--) {
+    if (parent_[k] == -1) {
+      begin_[k] = offset;
+      offset += counts[k];
+    }
+    end_[k] = begin_[k] + counts[k];
+    if (!isLeaf(k)) {
+      begin_[ left_[k] ] = begin_[k];
+      begin_[ right_[k] ] = begin_[k] + counts[ left_[k] ];
+    }
+  }
+  order_.resize(offset);
+  for (int k = 0; k < numLeaves_; k++) {
+    copy(groups[k].begin(), groups[k].end(), order_.begin() + begin_[k]);
+  }
+}
+
+int ComponentTree::find(vector<int> & sets, int k) {
+  int root = k;
+  while (sets[root] != root) root = sets[root];
+  while (sets[k] != root) {
+    int next = sets[k];
+    sets[k] = root;
+    k = next;
+  }
+  return root;
+}
+
+void ComponentTree::components(int node, double threshold, vector<int> & result) const {
+  vector<int> stack(1, node);
+  while (!stack.empty()) {
+    int k = stack.back();
+    stack.pop_back();
+    if (weight_[k] > threshold) {
+      result.push_back(k);
+    } else {
+      stack.push_back(right_[k]);
+      stack.push_back(left_[k]);
+    }
+  }
+}
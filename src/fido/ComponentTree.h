@@ -0,0 +1,54 @@
+// see license for more information
+
+#ifndef _ComponentTree_H
+#define _ComponentTree_H
+
+#include <vector>
+
+#include "CompressedBigraph.h"
+
+using namespace std;
+
+/*
+* ComponentTree records how groups of proteins merge into connected components
+*   as PSMs are added in order of descending weight (union-find with a merge
+*   tree). A node is a single component for every PSM threshold below its
+*   weight and falls apart into its two children at or above it, so the
+*   components of the graph for any threshold follow from the one sweep.
+*
+*/
+class ComponentTree {
+ public:
+  // the leaves are the given groups of proteins (each in ascending order);
+  // proteins outside the groups are ignored, as are PSMs with a weight
+  // <= minWeight
+  ComponentTree(const CompressedBigraph & graph, const vector<double> & psmWeights,
+                const vector<vector<int> > & groups, double minWeight);
+
+  int numNodes() const { return weight_.size(); }
+  int numLeaves() const { return numLeaves_; }
+  bool isLeaf(int node) const { return node < numLeaves_; }
+  int left(int node) const { return left_[node]; }
+  int right(int node) const { return right_[node]; }
+  int parent(int node) const { return parent_[node]; }
+  double weight(int node) const { return weight_[node]; }
+  int minProtein(int node) const { return minProtein_[node]; }
+
+  // the proteins of a node are proteinsOrder(k) for k in [begin, end)
+  int proteinsBegin(int node) const { return begin_[node]; }
+  int proteinsEnd(int node) const { return end_[node]; }
+  int proteinsOrder(int k) const { return order_[k]; }
+
+  // appends the components of the node at the threshold, i.e. the highest
+  // descendants that are still connected by a PSM with a larger weight
+  void components(int node, double threshold, vector<int> & result) const;
+
+ private:
+  int numLeaves_;
+  vector<int> left_, right_, parent_, minProtein_, begin_, end_, order_;
+  vector<double> weight_;
+
+  static int find(vector<int> & sets, int k);
+};
+
+#endif
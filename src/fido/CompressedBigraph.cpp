@@ -0,0 +1,204 @@
+// see license for more information
+
+#include "CompressedBigraph.h"
+
+#include <algorithm>
+
+CompressedBigraph::CompressedBigraph(int numPSMs, int numProteins,
+    const vector<pair<int, int> > & edges) {
+  int numEdges = edges.size();
+
+  // counting sort of the edges by protein and then, stably, by PSM, so that
+  // the proteins of each PSM come out in ascending order
+  vector<int> offsets(numProteins + 1, 0);
+  for (int k = 0; k < numEdges; k++) {
+    offsets[ edges[k].second + 1 ]++;
+  }
+  for (int k = 0; k < numProteins; k++) {
+    offsets[k + 1] += offsets[k];
+  }
+  vector<int> byProtein(numEdges);
+  for (int k = 0; k < numEdges; k++) {
+    byProtein[ offsets[ edges[k].second ]++ ] = k;
+  }
+
+  psmOffsets_.assign(numPSMs + 1, 0);
+  for (int k = 0; k < numEdges; k++) {
+    psmOffsets_[ edges[k].first + 1 ]++;
+  }
+  for (int k = 0; k < numPSMs; k++) {
+    psmOffsets_[k + 1] += psmOffsets_[k];
+  }
+  vector<int> fill(psmOffsets_.begin(), psmOffsets_.end() - 1);
+  psmAdjacency_.resize(numEdges);
+  for (int k = 0; k < numEdges; k++) {
+    const pair<int, int> & edge = edges[ byProtein[k] ];
+    psmAdjacency_[ fill[edge.first]++ ] = edge.second;
+  }
+
+  // remove duplicate edges, compacting the adjacency array in place
+  int write = 0;
+  for (int psm = 0; psm < numPSMs; psm++) {
+    int begin = psmOffsets_[psm], end = psmOffsets_[psm + 1];
+    psmOffsets_[psm] = write;
+    for (int j = begin; j < end; j++) {
+      if (j == begin || psmAdjacency_[j] != psmAdjacency_[j - 1]) {
+        psmAdjacency_[write++] = psmAdjacency_[j];
+      }
+    }
+  }
+  psmOffsets_[numPSMs] = write;
+  psmAdjacency_.resize(write);
+
+  buildProteinSide(numProteins);
+}
+
+// transposes the PSM side; iterating over the PSMs in order leaves the PSMs
+// of each protein in ascending order
+void CompressedBigraph::buildProteinSide(int numProteins) {
+  proteinOffsets_.assign(numProteins + 1, 0);
+  for (size_t k = 0; k < psmAdjacency_.size(); k++) {
+    proteinOffsets_[ psmAdjacency_[k] + 1 ]++;
+  }
+  for (int k = 0; k < numProteins; k++) {
+    proteinOffsets_[k + 1] += proteinOffsets_[k];
+  }
+  vector<int> fill(proteinOffsets_.begin(), proteinOffsets_.end() - 1);
+  proteinAdjacency_.resize(psmAdjacency_.size());
+  for (int psm = 0; psm < numPSMs(); psm++) {
+    for (int j = psmOffsets_[psm]; j < psmOffsets_[psm + 1]; j++) {
+      proteinAdjacency_[ fill[ psmAdjacency_[j] ]++ ] = psm;
+    }
+  }
+}
+
+CompressedBigraph CompressedBigraph::subgraph(const vector<bool> & keepPSMs,
+    const vector<bool> & keepProteins) const {
+  vector<int> newProteinIndex(numProteins(), -1);
+  int numKeptProteins = 0;
+  for (int k = 0; k < numProteins(); k++) {
+    if (keepProteins[k]) newProteinIndex[k] = numKeptProteins++;
+  }
+
+  // the renumbering is monotone, so the adjacency stays sorted
+  CompressedBigraph result;
+  for (int psm = 0; psm < numPSMs(); psm++) {
+    if (!keepPSMs[psm]) continue;
+    for (int j = psmOffsets_[psm]; j < psmOffsets_[psm + 1]; j++) {
+      int protein = newProteinIndex[ psmAdjacency_[j] ];
+      if (protein != -1) result.psmAdjacency_.push_back(protein);
+    }
+    result.psmOffsets_.push_back(result.psmAdjacency_.size());
+  }
+  result.buildProteinSide(numKeptProteins);
+  return result;
+}
+
+void CompressedBigraph::proteinReplicates(vector<vector<int> > & groups) const {
+  groups.clear();
+  int numProts = numProteins();
+
+  // order the proteins by a hash of their PSM sets, so that replicates
+  // are adjacent and only need to be compared within runs of equal hashes
+  vector<pair<unsigned int, int> > hashes(numProts);
+  for (int k = 0; k < numProts; k++) {
+    unsigned int hash = 2166136261u;
+    for (int j = proteinOffsets_[k]; j < proteinOffsets_[k + 1]; j++) {
+      hash = (hash ^ static_cast<unsigned int>(proteinAdjacency_[j])) * 16777619u;
+    }
+    hashes[k] = make_pair(hash, k);
+  }
+  sort(hashes.begin(), hashes.end());
+
+  vector<pair<int, int> > groupOfProtein; // (first member, protein)
+  groupOfProtein.reserve(numProts);
+  vector<int> representatives;
+  for (int start = 0; start < numProts; ) {
+    int end = start;
+    while (end < numProts && hashes[end].first == hashes[start].first) end++;
+
+    representatives.clear();
+    for (int k = start; k < end; k++) {
+      int protein = hashes[k].second;
+      int group = -1;
+      for (size_t r = 0; r < representatives.size() && group == -1; r++) {
+        int rep = representatives[r];
+        if (proteinDegree(rep) == proteinDegree(protein) &&
+            equal(proteinAdjacency_.begin() + proteinOffsets_[rep],
+                  proteinAdjacency_.begin() + proteinOffsets_[rep + 1],
+                  proteinAdjacency_.begin() + proteinOffsets_[protein])) {
+          group = rep;
+        }
+      }
+      if (group == -1) {
+        // proteins within a run are visited in ascending order
+        group = protein;
+        representatives.push_back(protein);
+      }
+      groupOfProtein.push_back(make_pair(group, protein));
+    }
+    start = end;
+  }
+
+  sort(groupOfProtein.begin(), groupOfProtein.end());
+  for (size_t k = 0; k < groupOfProtein.size(); k++) {
+    if (k == 0 || groupOfProtein[k].first != groupOfProtein[k - 1].first) {
+      groups.push_back(vector<int>());
+    }
+    groups.back().push_back(groupOfProtein[k].second);
+  }
+}
+
+int CompressedBigraph::markSections(const vector<double> & psmWeights,
+    double peptideThreshold, vector<int> & proteinSections,
+    vector<int> & psmSections, vector<bool> & multipleSections) const {
+  proteinSections.assign(numProteins(), -1);
+  psmSections.assign(numPSMs(), -1);
+  multipleSections.assign(numPSMs(), false);
+
+  vector<vector<int> > groups;
+  proteinReplicates(groups);
+  vector<int> firstInGroup(numProteins(), -1);
+  for (size_t k = 0; k < groups.size(); k++) {
+    for (size_t j = 1; j < groups[k].size(); j++) {
+      firstInGroup[ groups[k][j] ] = groups[k][0];
+    }
+  }
+
+  int section = 0;
+  vector<int> stack;
+  for (int k = 0; k < numProteins(); k++) {
+    if (firstInGroup[k] != -1) {
+      proteinSections[k] = proteinSections[ firstInGroup[k] ];
+      continue;
+    } else if (proteinSections[k] != -1) {
+      continue;
+    }
+
+    proteinSections[k] = section;
+    stack.push_back(k);
+    while (!stack.empty()) {
+      int protein = stack.back();
+      stack.pop_back();
+      for (int j = proteinOffsets_[protein]; j < proteinOffsets_[protein + 1]; j++) {
+        int psm = proteinAdjacency_[j];
+        if (psmSections[psm] == section) continue;
+        if (psmSections[psm] != -1) multipleSections[psm] = true;
+        psmSections[psm] = section;
+
+        // do not follow edges with PSM probability below peptideThreshold
+        if (psmWeights[psm] <= peptideThreshold) continue;
+        for (int i = psmOffsets_[psm]; i < psmOffsets_[psm + 1]; i++) {
+          int next = psmAdjacency_[i];
+          if (proteinSections[next] != section) {
+            proteinSections[next] = section;
+            stack.push_back(next);
+          }
+        }
+      }
+    }
+    section++;
+  }
+
+  return section;
+}
@@ -0,0 +1,81 @@
+// see license for more information
+
+#ifndef _CompressedBigraph_H
+#define _CompressedBigraph_H
+
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+/*
+* CompressedBigraph stores the edges between PSMs and proteins in compressed
+*   sparse row (CSR) form in both directions. Nodes are identified by their
+*   integer index; the neighbours of a node are a contiguous, ascending range
+*   of a single adjacency array, so the graph needs a handful of allocations
+*   regardless of its size.
+*
+*/
+class CompressedBigraph {
+ public:
+  CompressedBigraph() : psmOffsets_(1, 0), proteinOffsets_(1, 0) {}
+  // builds the graph from (PSM, protein) pairs; duplicate edges are removed
+  CompressedBigraph(int numPSMs, int numProteins,
+                    const vector<pair<int, int> > & edges);
+
+  void swap(CompressedBigraph & other) {
+    psmOffsets_.swap(other.psmOffsets_);
+    psmAdjacency_.swap(other.psmAdjacency_);
+    proteinOffsets_.swap(other.proteinOffsets_);
+    proteinAdjacency_.swap(other.proteinAdjacency_);
+  }
+
+  int numPSMs() const { return psmOffsets_.size() - 1; }
+  int numProteins() const { return proteinOffsets_.size() - 1; }
+  int numEdges() const { return psmAdjacency_.size(); }
+
+  int psmDegree(int psm) const {
+    return psmOffsets_[psm + 1] - psmOffsets_[psm];
+  }
+  int proteinOfPSM(int psm, int j) const {
+    return psmAdjacency_[ psmOffsets_[psm] + j ];
+  }
+  int proteinDegree(int protein) const {
+    return proteinOffsets_[protein + 1] - proteinOffsets_[protein];
+  }
+  int psmOfProtein(int protein, int j) const {
+    return proteinAdjacency_[ proteinOffsets_[protein] + j ];
+  }
+  // the neighbours of a node as a range of psmDegree/proteinDegree elements
+  vector<int>::const_iterator proteinsOfPSM(int psm) const {
+    return psmAdjacency_.begin() + psmOffsets_[psm];
+  }
+  vector<int>::const_iterator psmsOfProtein(int protein) const {
+    return proteinAdjacency_.begin() + proteinOffsets_[protein];
+  }
+
+  // keeps the marked nodes and the edges between them; the kept nodes are
+  // renumbered in their original order
+  CompressedBigraph subgraph(const vector<bool> & keepPSMs,
+                             const vector<bool> & keepProteins) const;
+
+  // groups of proteins with identical sets of PSMs, ordered by their first
+  // member, with the members of each group in ascending order
+  void proteinReplicates(vector<vector<int> > & groups) const;
+
+  // assigns the nodes to connected sections without following PSMs with a
+  // weight <= peptideThreshold; such PSMs can be reached from several
+  // sections, which is flagged in multipleSections. Proteins with identical
+  // PSM sets are always put in the same section. Returns the number of sections.
+  int markSections(const vector<double> & psmWeights, double peptideThreshold,
+                   vector<int> & proteinSections, vector<int> & psmSections,
+                   vector<bool> & multipleSections) const;
+
+ private:
+  vector<int> psmOffsets_, psmAdjacency_;
+  vector<int> proteinOffsets_, proteinAdjacency_;
+
+  void buildProteinSide(int numProteins);
+};
+
+#endif
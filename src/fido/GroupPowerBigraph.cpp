@@ -2,18 +2,57 @@
 // see license for more information
 
 #include "GroupPowerBigraph.h"
+#include "ComponentTree.h"
 
 GroupPowerBigraph::~GroupPowerBigraph() { }
 
 Array<double> GroupPowerBigraph::proteinProbs() {
+  // the subgraphs are independent; the expensive ones are handed out first
+  // and the results are appended in subgraph order afterwards
+  int numSubgraphs = subgraphs_.size();
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int k = 0; k < numSubgraphs; k++) {
+    subgraphs_[ subgraphOrder_[k] ].getProteinProbs(params_);
+  }
+  
   Array<double> result;
-  for (int k = 0; k < subgraphs_.size(); k++) {
-    subgraphs_[k].getProteinProbs(params_);
+  for (int k = 0; k < numSubgraphs; k++) {
     result.append( subgraphs_[k].proteinProbabilities() );
   }
   return result;
 }
 
+// computes the protein probabilities for the given parameters without
+// modifying the graph, so that several models can be evaluated concurrently
+void GroupPowerBigraph::proteinProbs(const Model& m, Array<double>& probs) const {
+  probs.clear();
+  for (int k = 0; k < subgraphs_.size(); k++) {
+    Array<double> subgraphProbs;
+    subgraphs_[k].getProteinProbs(m, subgraphProbs);
+    probs.append(subgraphProbs);
+  }
+}
+
+// orders the subgraphs by descending estimated cost, i.e. the number of
+// configurations (or, with belief propagation, of groups) times the number
+// of PSMs evaluated for each of them
+void GroupPowerBigraph::setSubgraphOrder() {
+  std::vector<std::pair<double, int> > costs;
+  for (int k = 0; k < subgraphs_.size(); k++) {
+    const BasicGroupBigraph & bgb = subgraphs_[k];
+    double logCost = (bgb.getApproximate() ? log2(bgb.getOriginalN().size() + 1) : 
+                      bgb.logNumberOfConfigurations()) + 
+                     log2(bgb.PSMsToProteins.size() + 1);
+    costs.push_back(std::make_pair(-logCost, k));
+  }
+  std::sort(costs.begin(), costs.end());
+  
+  subgraphOrder_ = Array<int>(costs.size());
+  for (int k = 0; k < subgraphOrder_.size(); k++) {
+    subgraphOrder_[k] = costs[k].second;
+  }
+}
+
 void GroupPowerBigraph::getProteinProbs() {
   probsPresentProteins_ = proteinProbs();
 }
@@ -72,22 +111,46 @@ void GroupPowerBigraph::getProteinNames(std::vector<std::vector<std::string> > &
 void GroupPowerBigraph::getProteinProbsAndNames(
     std::vector<std::vector<std::string> > &names, 
     std::vector<double> &probs) const {
+  getProteinProbsAndNames(probsPresentProteins_, names, probs);
+}
+
+void GroupPowerBigraph::getProteinProbsAndNames(
+    const Array<double> &probsPresentProteins,
+    std::vector<std::vector<std::string> > &names, 
+    std::vector<double> &probs) const {
+  std::vector<int> order;
+  getProteinRanking(probsPresentProteins, order, probs);
+  
   names.clear();
-  probs.clear();
+  for (size_t k = 0; k < order.size(); k++) {
+    if (order[k] < groupProtNames_.size()) {
+      names.push_back(groupProtNames_[ order[k] ].getVector());
+    } else {
+      names.push_back(severedProteins_.getVector());
+    }
+  }
+}
+
+void GroupPowerBigraph::getProteinRanking(
+    const Array<double> &probsPresentProteins,
+    std::vector<int> &order, std::vector<double> &peps) const {
+  order.clear();
+  peps.clear();
   
-  Array<double> sorted = probsPresentProteins_;
+  Array<double> sorted = probsPresentProteins;
   Array<int> indices = sorted.sort();
   for (int k=0; k<sorted.size(); k++) {
     double pep = (1.0 - sorted[k]);
     if (pep <= 0.0) pep = 0.0;
     if (pep >= 1.0) pep = 1.0;
-    names.push_back(groupProtNames_[ indices[k] ].getVector());
-    probs.push_back(pep);
+    order.push_back(indices[k]);
+    peps.push_back(pep);
   }
   
+  // the severed proteins come last, as in getProteinNames
   if (severedProteins_.size() != 0) {
-    names.push_back(severedProteins_.getVector());
-    probs.push_back(1.0);
+    order.push_back(groupProtNames_.size());
+    peps.push_back(1.0);
   }
 }
 
@@ -101,37 +164,299 @@ double GroupPowerBigraph::getLogNumberStates() const {
   return total + 1;
 }
 
+namespace {
+  // a PSM of a component; clones carry their own name
+  struct ComponentPSM {
+    int index, name;
+    ComponentPSM(int i, int n) : index(i), name(n) {}
+  };
+
+  // a component that is yet to be checked: nodes of the ComponentTree and,
+  // before its first split, the proteins that splitting would sever
+  struct PendingComponent {
+    vector<int> nodes, lowProteins;
+    vector<ComponentPSM> psms;
+    double threshold, logNumConfig, allowance;
+    int section, firstProtein;
+    
+    PendingComponent() : threshold(0.0), logNumConfig(0.0), allowance(0.0),
+        section(0), firstProtein(0) {}
+    
+    void swap(PendingComponent & rhs) {
+      nodes.swap(rhs.nodes);
+      lowProteins.swap(rhs.lowProteins);
+      psms.swap(rhs.psms);
+      std::swap(threshold, rhs.threshold);
+      std::swap(logNumConfig, rhs.logNumConfig);
+      std::swap(allowance, rhs.allowance);
+      std::swap(section, rhs.section);
+      std::swap(firstProtein, rhs.firstProtein);
+    }
+  };
+  
+  struct AscendingSize {
+    const vector<double> & sizes;
+    AscendingSize(const vector<double> & s) : sizes(s) {}
+    bool operator()(int a, int b) const { return sizes[a] < sizes[b]; }
+  };
+  
+  // splits a total of 2^logBudget configurations between components of 
+  // 2^logSizes configurations: components that fit in an equal share of 
+  // what is left keep their full size, the others get an equal share of the
+  // remainder (all in log2)
+  void shareBudget(double logBudget, const vector<double> & logSizes, 
+                   vector<double> & allowances) {
+    int n = logSizes.size();
+    vector<int> order(n);
+    for (int k = 0; k < n; k++) order[k] = k;
+    stable_sort(order.begin(), order.end(), AscendingSize(logSizes));
+    
+    allowances.resize(n);
+    double remaining = logBudget;
+    int k = 0;
+    for (; k < n; k++) {
+      double size = logSizes[ order[k] ];
+      if (size > remaining - log2(n - k)) break;
+      allowances[ order[k] ] = size;
+      remaining += log2(1.0 - pow(2.0, size - remaining));
+    }
+    double share = max(0.0, remaining - log2(n - k));
+    for (; k < n; k++) allowances[ order[k] ] = share;
+  }
+}
+
+bool GroupPowerBigraph::isApproximated(double logNumConfig) const {
+  return approximationThreshold_ > 0.0 && logNumConfig > approximationThreshold_;
+}
+
+// log2 of the number of configurations of a group of proteins, as counted
+// by BasicGroupBigraph::logNumberOfConfigurations
+double GroupPowerBigraph::groupLogNumberOfConfigurations(int groupSize) const {
+  return noClustering_ ? groupSize : log2(groupSize + 1);
+}
+
+// Partitions the pruned graph into components of at most 
+// LOG_MAX_ALLOWED_CONFIGURATIONS or, with a configuration budget, at most
+// the allowance of the section they come from. Components that are too large are split by
+// raising the peptide threshold, cloning the PSMs that end up shared between
+// the parts. The components for every threshold are read off a ComponentTree
+// built in one sweep over the PSMs, and the subgraphs are only built for the
+// final partition; the result matches pruning and partitioning each 
+// component again for every raised threshold.
 Array<BasicBigraph> GroupPowerBigraph::iterativePartitionSubgraphs(BasicBigraph & bb, double newPeptideThreshold) {
   bb.setPeptideThreshold(newPeptideThreshold);
   bb.prune();
   severedProteins_.append( bb.severedProteins );
-
-  Array<BasicBigraph> preResult = bb.partitionSections();
-  Array<BasicBigraph> result;
   
+  const CompressedBigraph & graph = bb.graph;
+  vector<double> psmWeights = bb.PSMsToProteins.weights.getVector();
+  int numProteins = graph.numProteins();
+  
+  // proteins with identical PSMs are never separated and become one group
+  vector<vector<int> > replicates;
+  graph.proteinReplicates(replicates);
+  vector<int> groupOfProtein(numProteins);
+  for (size_t k = 0; k < replicates.size(); k++) {
+    for (size_t j = 0; j < replicates[k].size(); j++) {
+      groupOfProtein[ replicates[k][j] ] = k;
+    }
+  }
+  
+  // a component that is split is pruned with the default thresholds of 
+  // BasicBigraph, which severs the proteins without a PSM reaching its 
+  // protein threshold; these are left out of the tree
+  BasicBigraph defaults;
+  double splitProteinThreshold = defaults.getProteinThreshold();
+  vector<bool> low(numProteins);
+  for (int k = 0; k < numProteins; k++) {
+    double best = -Numerical::inf();
+    for (int j = 0; j < graph.proteinDegree(k); j++) {
+      best = max(best, psmWeights[ graph.psmOfProtein(k, j) ]);
+    }
+    low[k] = best < splitProteinThreshold;
+  }
+  vector<vector<int> > treeGroups;
+  for (size_t k = 0; k < replicates.size(); k++) {
+    if (!low[ replicates[k][0] ]) treeGroups.push_back(replicates[k]);
+  }
+  
+  ComponentTree tree(graph, psmWeights, treeGroups, newPeptideThreshold);
+  vector<double> nodeLogNumConfig(tree.numNodes());
+  for (int k = 0; k < tree.numNodes(); k++) {
+    nodeLogNumConfig[k] = tree.isLeaf(k) ? 
+        groupLogNumberOfConfigurations(treeGroups[k].size()) :
+        nodeLogNumConfig[ tree.left(k) ] + nodeLogNumConfig[ tree.right(k) ];
+  }
+  
+  // the sections of the pruned graph are the starting components; they are
+  // stacked in reverse so that the result comes out in depth-first order
+  vector<int> proteinSections, psmSections;
+  vector<bool> multipleSections;
+  int numSections = graph.markSections(psmWeights, newPeptideThreshold, 
+      proteinSections, psmSections, multipleSections);
+  vector<PendingComponent> stack(numSections);
+  for (int k = 0; k < numSections; k++) {
+    stack[numSections - 1 - k].threshold = newPeptideThreshold;
+    stack[numSections - 1 - k].section = k;
+  }
+  for (int k = tree.numNodes() - 1; k >= 0; k--) {
+    if (tree.parent(k) == -1) {
+      int sect = proteinSections[ tree.minProtein(k) ];
+      stack[numSections - 1 - sect].nodes.push_back(k);
+    }
+  }
+  for (int k = 0; k < numProteins; k++) {
+    if (low[k]) stack[numSections - 1 - proteinSections[k]].lowProteins.push_back(k);
+  }
+  for (int k = 0; k < graph.numPSMs(); k++) {
+    stack[numSections - 1 - psmSections[k]].psms.push_back(ComponentPSM(k, -1));
+  }
+  
+  vector<double> logSizes;
+  for (int i = 0; i < numSections; i++) {
+    PendingComponent & component = stack[i];
+    component.logNumConfig = 0.0;
+    component.firstProtein = numProteins;
+    for (size_t k = 0; k < component.nodes.size(); k++) {
+      component.logNumConfig += nodeLogNumConfig[ component.nodes[k] ];
+      component.firstProtein = min(component.firstProtein, tree.minProtein(component.nodes[k]));
+    }
+    for (size_t k = 0; k < component.lowProteins.size(); k++) {
+      int protein = component.lowProteins[k];
+      const vector<int> & group = replicates[ groupOfProtein[protein] ];
+      if (group[0] == protein) {
+        component.logNumConfig += groupLogNumberOfConfigurations(group.size());
+      }
+      component.firstProtein = min(component.firstProtein, protein);
+    }
+    component.allowance = LOG_MAX_ALLOWED_CONFIGURATIONS;
+    if (!isApproximated(component.logNumConfig)) {
+      logSizes.push_back(component.logNumConfig);
+    }
+  }
+  
+  // the sections solved exactly share the budget, and the parts of a split
+  // section keep its allowance
+  if (logConfigurationBudget_ > 0.0) {
+    vector<double> allowances;
+    shareBudget(logConfigurationBudget_, logSizes, allowances);
+    for (int i = 0, j = 0; i < numSections; i++) {
+      if (!isApproximated(stack[i].logNumConfig)) stack[i].allowance = allowances[j++];
+    }
+  }
+  
+  vector<string> cloneNames;
+  vector<PendingComponent> finished;
+  vector<int> stamps(numProteins, -1), labels(numProteins);
+  int stamp = 0;
   bool warnTooManyConfigurations = false;
   
-  for (int k = 0; k < preResult.size(); k++) {
-    BasicGroupBigraph bgb = BasicGroupBigraph(peptidePrior_, preResult[k], noClustering_/*,trivialGrouping_*/);
-    double logNumConfig = bgb.logNumberOfConfigurations();
-    if ( newPeptideThreshold >= 0.0 &&
-         logNumConfig > LOG_MAX_ALLOWED_CONFIGURATIONS && 
-         log2(bgb.PSMsToProteins.size())+log2(bgb.getOriginalN()[0].size+1) <= LOG_MAX_ALLOWED_CONFIGURATIONS ) {
-      double newThresh = 1.25*(newPeptideThreshold + 1e-6);
-      Array<BasicBigraph> completelyFragmented = iterativePartitionSubgraphs(preResult[k], newThresh);
-      result.append( completelyFragmented );
-    } else if (newPeptideThreshold >= 0.0 && logNumConfig > LOG_MAX_ALLOWED_CONFIGURATIONS) {
-      // the graph cannot become pruned to the desired efficiency;
-      // prune as much as possible
-      double largest = Vector(preResult[k].PSMsToProteins.weights).max();
-      Array<BasicBigraph> completelyFragmented = iterativePartitionSubgraphs(preResult[k], largest);
-      result.append( completelyFragmented );
-    } else {
-      if (newPeptideThreshold < 0.0 && logNumConfig > LOG_MAX_ALLOWED_CONFIGURATIONS) {
-        warnTooManyConfigurations = true;
+  while (!stack.empty()) {
+    PendingComponent component;
+    component.swap(stack.back());
+    stack.pop_back();
+    
+    double threshold = component.threshold;
+    bool split = false;
+    // components solved approximately are kept whole
+    bool tooLarge = !isApproximated(component.logNumConfig) && 
+                    component.logNumConfig > component.allowance;
+    if (threshold >= 0.0 && tooLarge) {
+      bool singleNode = component.lowProteins.empty() && component.nodes.size() == 1;
+      int firstGroupSize = noClustering_ ? 1 : replicates[ groupOfProtein[component.firstProtein] ].size();
+      if (log2(component.psms.size()) + log2(firstGroupSize + 1) <= component.allowance) {
+        threshold = 1.25*(threshold + 1e-6);
+        // raising the threshold leaves the component unchanged until it 
+        // passes the weight of the PSM holding it together
+        while (singleNode && !tree.isLeaf(component.nodes[0]) && 
+               tree.weight(component.nodes[0]) > threshold) {
+          threshold = 1.25*(threshold + 1e-6);
+        }
+      } else {
+        // the graph cannot become pruned to the desired efficiency;
+        // prune as much as possible
+        threshold = -Numerical::inf();
+        for (size_t k = 0; k < component.psms.size(); k++) {
+          threshold = max(threshold, psmWeights[ component.psms[k].index ]);
+        }
       }
+      // a single group of proteins cannot be split any further
+      split = !(singleNode && tree.isLeaf(component.nodes[0]));
+    } else if (threshold < 0.0 && tooLarge) {
+      warnTooManyConfigurations = true;
+    }
+    
+    if (!split) {
       // the graph is already pruned to the desired degree
-      result.add( preResult[k] );
+      finished.push_back(PendingComponent());
+      finished.back().swap(component);
+      continue;
+    }
+    
+    for (size_t k = 0; k < component.lowProteins.size(); k++) {
+      severedProteins_.add( bb.proteinsToPSMs.names[ component.lowProteins[k] ] );
+    }
+    
+    // the parts are numbered in order of their first protein
+    vector<int> parts;
+    for (size_t k = 0; k < component.nodes.size(); k++) {
+      tree.components(component.nodes[k], threshold, parts);
+    }
+    vector<pair<int, int> > partOrder;
+    for (size_t k = 0; k < parts.size(); k++) {
+      partOrder.push_back(make_pair(tree.minProtein(parts[k]), parts[k]));
+    }
+    sort(partOrder.begin(), partOrder.end());
+    int numParts = partOrder.size();
+    for (int i = 0; i < numParts; i++) {
+      int node = partOrder[i].second;
+      for (int k = tree.proteinsBegin(node); k < tree.proteinsEnd(node); k++) {
+        stamps[ tree.proteinsOrder(k) ] = stamp;
+        labels[ tree.proteinsOrder(k) ] = i;
+      }
+    }
+    
+    // PSMs shared between parts are replaced by a clone for every part they
+    // are connected to, placed after the other PSMs of the part
+    vector<PendingComponent> children(numParts);
+    vector<vector<ComponentPSM> > clones(numParts);
+    vector<int> psmParts;
+    for (size_t k = 0; k < component.psms.size(); k++) {
+      const ComponentPSM & psm = component.psms[k];
+      psmParts.clear();
+      for (int j = 0; j < graph.psmDegree(psm.index); j++) {
+        int protein = graph.proteinOfPSM(psm.index, j);
+        if (stamps[protein] == stamp) psmParts.push_back(labels[protein]);
+      }
+      sort(psmParts.begin(), psmParts.end());
+      psmParts.erase(unique(psmParts.begin(), psmParts.end()), psmParts.end());
+      
+      if (psmParts.size() == 1) {
+        children[ psmParts[0] ].psms.push_back(psm);
+        continue;
+      }
+      for (size_t j = 0; j < psmParts.size(); j++) {
+        ostringstream ost;
+        ost << (psm.name == -1 ? bb.PSMsToProteins.names[psm.index] : cloneNames[psm.name]) 
+            << "_clone_" << psmParts[j];
+        cloneNames.push_back(ost.str());
+        clones[ psmParts[j] ].push_back(ComponentPSM(psm.index, cloneNames.size() - 1));
+      }
+    }
+    stamp++;
+    
+    for (int i = numParts - 1; i >= 0; i--) {
+      PendingComponent & child = children[i];
+      int node = partOrder[i].second;
+      child.nodes.push_back(node);
+      child.psms.insert(child.psms.end(), clones[i].begin(), clones[i].end());
+      child.threshold = threshold;
+      child.logNumConfig = nodeLogNumConfig[node];
+      child.allowance = component.allowance;
+      child.section = i;
+      child.firstProtein = tree.minProtein(node);
+      stack.push_back(PendingComponent());
+      stack.back().swap(child);
     }
   }
   
@@ -139,6 +464,44 @@ Array<BasicBigraph> GroupPowerBigraph::iterativePartitionSubgraphs(BasicBigraph
     std::cerr << "WARNING: more than 2^18 possible configurations, run time will be long.\n"
       << "Consider turning off the -C flag to reduce the number of configurations automatically.\n" << std::endl;
   
+  // build the subgraphs of the final components
+  Array<BasicBigraph> result(finished.size());
+  for (int k = 0; k < result.size(); k++) {
+    const PendingComponent & component = finished[k];
+    vector<int> proteins = component.lowProteins;
+    for (size_t i = 0; i < component.nodes.size(); i++) {
+      int node = component.nodes[i];
+      for (int j = tree.proteinsBegin(node); j < tree.proteinsEnd(node); j++) {
+        proteins.push_back(tree.proteinsOrder(j));
+      }
+    }
+    sort(proteins.begin(), proteins.end());
+    
+    BasicBigraph & sub = result[k];
+    for (size_t i = 0; i < proteins.size(); i++) {
+      stamps[ proteins[i] ] = stamp;
+      labels[ proteins[i] ] = i;
+      sub.proteinsToPSMs.names.add( bb.proteinsToPSMs.names[ proteins[i] ] );
+      sub.proteinsToPSMs.weights.add( bb.proteinsToPSMs.weights[ proteins[i] ] );
+      sub.proteinsToPSMs.sections.add( component.section );
+    }
+    
+    vector<pair<int, int> > edges;
+    for (size_t i = 0; i < component.psms.size(); i++) {
+      const ComponentPSM & psm = component.psms[i];
+      sub.PSMsToProteins.names.add( psm.name == -1 ? 
+          bb.PSMsToProteins.names[psm.index] : cloneNames[psm.name] );
+      sub.PSMsToProteins.weights.add( psmWeights[psm.index] );
+      sub.PSMsToProteins.sections.add( component.section );
+      for (int j = 0; j < graph.psmDegree(psm.index); j++) {
+        int protein = graph.proteinOfPSM(psm.index, j);
+        if (stamps[protein] == stamp) edges.push_back(make_pair(i, labels[protein]));
+      }
+    }
+    stamp++;
+    CompressedBigraph(component.psms.size(), proteins.size(), edges).swap(sub.graph);
+  }
+  
   return result;
 }
 
@@ -175,6 +538,10 @@ void GroupPowerBigraph::initialize(BasicBigraph& basicBigraph) {
       subgraphs_[k] = BasicGroupBigraph(peptidePrior_, subBasic[k], noClustering_, trivialGrouping_);
     }
   }
+  for (int k = 0; k < subgraphs_.size(); k++) {
+    subgraphs_[k].setApproximate( isApproximated(subgraphs_[k].logNumberOfConfigurations()) );
+  }
+  setSubgraphOrder();
   getGroupProtNames();
 }
 
@@ -31,13 +31,21 @@ class GroupPowerBigraph {
         LOG_MAX_ALLOWED_CONFIGURATIONS(18),
         psmThreshold_(0.0), peptideThreshold_(1e-3),
         proteinThreshold_(1e-3), peptidePrior_(0.1),
-        trivialGrouping_(trivialGrouping) {}
+        trivialGrouping_(trivialGrouping), approximationThreshold_(0.0),
+        logConfigurationBudget_(0.0) {}
   ~GroupPowerBigraph();
   
   Array<double> proteinProbs();
+  void proteinProbs(const Model& m, Array<double>& probs) const;
   void printProteinWeights() const;
   void getProteinProbsPercolator(std::multimap<double, std::vector<std::string> > &pepProteins) const;
   void getProteinProbsAndNames(std::vector<std::vector<std::string> > &names, std::vector<double> &probs) const;
+  void getProteinProbsAndNames(const Array<double> &probsPresentProteins, 
+      std::vector<std::vector<std::string> > &names, std::vector<double> &probs) const;
+  // as getProteinProbsAndNames, but with each group given by its index into
+  // getProteinNames instead of a copy of its names
+  void getProteinRanking(const Array<double> &probsPresentProteins, 
+      std::vector<int> &order, std::vector<double> &peps) const;
   void getProteinNames(std::vector<std::vector<std::string> > &names) const;
   void getProteinProbs();
   Array<string> peptideNames() const;
@@ -82,6 +90,12 @@ class GroupPowerBigraph {
   void setMultipleLabeledPeptides(bool b) { addPeptideDecoyLabel_ = b; }
   bool getMultipleLabeledPeptides() const { return addPeptideDecoyLabel_; }
   
+  void setApproximationThreshold(double t) { approximationThreshold_ = t; }
+  double getApproximationThreshold() const { return approximationThreshold_; }
+  
+  void setConfigurationBudget(double b) { logConfigurationBudget_ = b; }
+  double getConfigurationBudget() const { return logConfigurationBudget_; }
+  
   void read(Scores* fullset);
   void read(istream & is);
   //NOTE to clone object
@@ -89,8 +103,11 @@ class GroupPowerBigraph {
 private:
   void initialize(BasicBigraph& basicBigraph);
   void getGroupProtNames();
+  void setSubgraphOrder();
   
   Array<BasicBigraph> iterativePartitionSubgraphs(BasicBigraph & bb, double newPeptideThreshold );
+  double groupLogNumberOfConfigurations(int groupSize) const;
+  bool isApproximated(double logNumConfig) const;
   
   /* struct with alpha, beta and gamma parameter (Fig 2 in Serang et al. 2010) */
   Model params_;
@@ -112,6 +129,13 @@ private:
   double peptidePrior_;
   /* groups are either present or absent and cannot be partially present */
   bool trivialGrouping_;
+  /* log2 number of configurations above which a subgraph is not split but
+     solved approximately with loopy belief propagation; 0 turns this off */
+  double approximationThreshold_;
+  /* log2 of the total number of configurations shared between the sections
+     of the graph, replacing the fixed LOG_MAX_ALLOWED_CONFIGURATIONS of each
+     component; 0 turns this off */
+  double logConfigurationBudget_;
   /* proteins that have no PSMs remaining after pruning */
   Array<std::string> severedProteins_;
   /* probabilities for each protein to be present ("R" in Serang et al. 2010) */
@@ -120,6 +144,8 @@ private:
   Array<Array<std::string> > groupProtNames_;
   /* subgraphs resulting from the partitioning and pruning steps */
   Array<BasicGroupBigraph> subgraphs_;
+  /* subgraph indices in descending order of estimated computational cost */
+  Array<int> subgraphOrder_;
 };
 
 ostream & operator <<(ostream & os, pair<double,double> rhs);
@@ -7,6 +7,7 @@
 using namespace std;
 
 #include <cmath>
+#include <vector>
 #include "Combinatorics.h"
 
 #include <iostream>
@@ -23,10 +24,71 @@ using namespace std;
 */
 class Model {
  protected:
+  // tables of the probabilities used in the inner loops of the enumeration,
+  // rebuilt whenever the parameters are changed through the setters; if the
+  // parameters were modified directly, the values are computed on the fly
+  static const int kMaxTabulatedProteins = 64;
+  double tableAlpha_, tableBeta_, tableGamma_;
+  std::vector<double> noEmissionTable_;
+  std::vector<double> proteinsTable_;
+  
+  static int proteinsTableIndex(int totalProts, int activeProts) {
+    return totalProts * (totalProts + 1) / 2 + activeProts;
+  }
+  
+  // the binomial coefficients do not depend on the parameters, so they are
+  // only computed once
+  static const std::vector<double> & logBinomialTable() {
+    static std::vector<double> table = buildLogBinomialTable();
+    return table;
+  }
+  
+  static std::vector<double> buildLogBinomialTable() {
+    std::vector<double> table(proteinsTableIndex(kMaxTabulatedProteins, 0));
+    for (int n = 0; n < kMaxTabulatedProteins; n++)
+      for (int k = 0; k <= n; k++)
+        table[ proteinsTableIndex(n, k) ] = Combinatorics::logBinomial(n, k);
+    return table;
+  }
+  
+  bool tablesValid() const {
+    return !noEmissionTable_.empty() && tableAlpha_ == alpha && 
+           tableBeta_ == beta && tableGamma_ == gamma;
+  }
+  
+  void buildTables() {
+    tableAlpha_ = alpha;
+    tableBeta_ = beta;
+    tableGamma_ = gamma;
+    
+    noEmissionTable_.resize(kMaxTabulatedProteins);
+    for (int k = 0; k < kMaxTabulatedProteins; k++)
+      noEmissionTable_[k] = computeProbabilityNoEmissionFrom(k);
+    
+    const std::vector<double> & logBinomials = logBinomialTable();
+    proteinsTable_.resize(logBinomials.size());
+    for (int n = 0; n < kMaxTabulatedProteins; n++) {
+      for (int k = 0; k <= n; k++) {
+        int idx = proteinsTableIndex(n, k);
+        proteinsTable_[idx] = pow(2.0, logBinomials[idx] + k*log2(gamma) + (n-k) * log2(1-gamma) );
+      }
+    }
+  }
+  
+  double computeProbabilityNoEmissionFrom(int numActiveProts) const {
+    // using log for greater precision
+    return pow(2.0, log2( 1-beta )+numActiveProts * log2(1-alpha) );
+  }
+  
+  double computeProbabilityProteins(int totalProts, int activeProts) const {
+    // using log for greater precision
+    return pow(2.0, Combinatorics::logBinomial(totalProts, activeProts) + activeProts*log2(gamma) + (totalProts-activeProts) * log2(1-gamma) );
+  }
+  
  public:
   double alpha, beta, gamma;
-  Model() { alpha = beta = gamma = -1; }
-  Model(double a, double b, double g) : alpha(a), beta(b), gamma(g) { }
+  Model() : tableAlpha_(-1), tableBeta_(-1), tableGamma_(-1) { alpha = beta = gamma = -1; }
+  Model(double a, double b, double g) : alpha(a), beta(b), gamma(g) { buildTables(); }
 
   friend bool operator ==(const Model & lhs, const Model & rhs) {
     return lhs.alpha == rhs.alpha && lhs.beta == rhs.beta && lhs.gamma == rhs.gamma;
@@ -35,12 +97,14 @@ class Model {
   void setAlphaBeta(double a, double b) {
     alpha = a;
     beta = b;
+    buildTables();
   }
   
   void setAlphaBetaGamma(double a, double b, double g) {
     alpha = a;
     beta = b;
     gamma = g;
+    buildTables();
   }
 
   double associatedEmission() const { return alpha; }
@@ -48,14 +112,16 @@ class Model {
   
   // probability that a peptide is not emitted, given @numActivProts
   double probabilityNoEmissionFrom(int numActiveProts) const {
-    // using log for greater precision
-    return pow(2.0, log2( 1-beta )+numActiveProts * log2(1-alpha) );
+    if (numActiveProts < kMaxTabulatedProteins && tablesValid())
+      return noEmissionTable_[numActiveProts];
+    return computeProbabilityNoEmissionFrom(numActiveProts);
   }
   
   // probability that @activeProts are present, given @totalProts
   double probabilityProteins(int totalProts, int activeProts) const {
-    // using log for greater precision
-    return pow(2.0, Combinatorics::logBinomial(totalProts, activeProts) + activeProts*log2(gamma) + (totalProts-activeProts) * log2(1-gamma) );
+    if (totalProts < kMaxTabulatedProteins && tablesValid())
+      return proteinsTable_[ proteinsTableIndex(totalProts, activeProts) ];
+    return computeProbabilityProteins(totalProts, activeProts);
   }
 
   friend ostream & operator <<(ostream & os, const Model & m) {
@@ -150,7 +216,10 @@ class GridModel : public Model {
   bool inRange() const { return alphaRange.inRange() && betaRange.inRange(); }
   void setalphaRange(RealRange __alphaRange) { alphaRange = __alphaRange; }  
   void setbetaRange(RealRange __betaRange) { betaRange = __betaRange; }  
-  void setGamma(double __gamma) { gamma = __gamma; }
+  void setGamma(double __gamma) { 
+    gamma = __gamma; 
+    buildTables();
+  }
 };
 
 #endif
@@ -15,6 +15,7 @@
 #include <fcntl.h>
 #ifndef _MSC_VER
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #endif
@@ -222,6 +223,111 @@ void Database::addProtein(
   }
 }
 
+/**
+ * Parses a database from the text based fasta file in the filename
+ * member variable, memory mapping the file and parsing its proteins in
+ * parallel. A record starts at the first line starting with '>', or at
+ * the first '>' after the title line of the previous record, as in
+ * parseTextFasta.
+ * \returns true if success. false if failure.
+ */
+bool Database::parseMemmapFasta()
+{
+#ifdef _MSC_VER
+  return parseTextFasta();
+#else
+  if(is_parsed_){
+    return true;
+  }
+  if(use_light_protein_){
+    return parseTextFasta();
+  }
+
+  int file_d = open(fasta_filename_.c_str(), O_RDONLY);
+  if(file_d < 0){
+    return false;
+  }
+  struct stat file_stat;
+  if(fstat(file_d, &file_stat) != 0 || file_stat.st_size <= 0){
+    close(file_d);
+    return parseTextFasta();
+  }
+  size_t file_size = file_stat.st_size;
+  void* data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, file_d, 0);
+  close(file_d);
+  if(data == MAP_FAILED){
+    return parseTextFasta();
+  }
+  const char* begin = (const char*)data;
+  const char* end = begin + file_size;
+
+  // find the record boundaries
+  std::vector<size_t> record_starts;
+  const char* pos = begin;
+  while(pos < end && *pos != '>'){
+    pos = (const char*)memchr(pos, '\n', end - pos);
+    pos = (pos == NULL) ? end : pos + 1;
+  }
+  while(pos < end){
+    record_starts.push_back(pos - begin);
+    pos = (const char*)memchr(pos, '\n', end - pos);
+    if(pos == NULL){
+      break;
+    }
+    pos = (const char*)memchr(pos, '>', end - pos);
+    if(pos == NULL){
+      break;
+    }
+  }
+  record_starts.push_back(file_size);
+
+  // size the arena to the sequences alone, each with its terminating null
+  int num_records = (int)record_starts.size() - 1;
+  std::vector<size_t> sequence_starts(num_records + 1, 0);
+#pragma omp parallel for schedule(static)
+  for(int record_idx = 0; record_idx < num_records; ++record_idx){
+    sequence_starts[record_idx + 1] = Protein::fastaRecordSequenceLength(
+        begin + record_starts[record_idx], 
+        begin + record_starts[record_idx + 1]) + 1;
+  }
+  for(int record_idx = 0; record_idx < num_records; ++record_idx){
+    sequence_starts[record_idx + 1] += sequence_starts[record_idx];
+  }
+  std::vector<char>(sequence_starts[num_records]).swap(sequence_arena_);
+
+  std::vector<Protein*> new_proteins(num_records);
+  std::vector<char> has_id(num_records);
+#pragma omp parallel for schedule(static)
+  for(int record_idx = 0; record_idx < num_records; ++record_idx){
+    size_t start = record_starts[record_idx];
+    Protein* new_protein = new Protein();
+    has_id[record_idx] = new_protein->parseProteinFastaRecord(begin + start,
+        begin + record_starts[record_idx + 1], 
+        &sequence_arena_[sequence_starts[record_idx]], start);
+    new_proteins[record_idx] = new_protein;
+  }
+  munmap(data, file_size);
+
+  // a title line without an id keeps the id of the previous protein, as
+  // in parseProteinFastaFile; setDatabase is not thread safe
+  char* previous_id = NULL;
+  for(int record_idx = 0; record_idx < num_records; ++record_idx){
+    Protein* new_protein = new_proteins[record_idx];
+    if(has_id[record_idx]){
+      previous_id = new_protein->getIdPointer();
+    }else{
+      new_protein->setId(previous_id == NULL ? "" : previous_id);
+    }
+    proteins_->push_back(new_protein);
+    new_protein->setProteinIdx(proteins_->size()-1);
+    new_protein->setDatabase(this);
+  }
+
+  is_parsed_ = true;
+  return true;
+#endif
+}
+
 /**
  * Parses a database from the text based fasta file in the filename
  * member variable
@@ -324,7 +430,7 @@ bool Database::parseTextFasta()
  */
 bool Database::parse()
 {
-  return parseTextFasta();
+  return parseMemmapFasta();
 }
 
 /**
@@ -54,6 +54,7 @@ class Database {
   long file_size_; ///< the size of the binary fasta file, when memory mapping
   DECOY_TYPE_T decoys_; ///< the type of decoys, none if target db
   bool binary_is_temp_; ///< should we delete the binary fasta in destructor
+  std::vector<char> sequence_arena_; ///< sequences of the parsed proteins
 
   /**
    * Parses a database from the text based fasta file in the filename
@@ -66,6 +67,16 @@ class Database {
    */
   bool parseTextFasta();
 
+  /**
+   * Parses a database from the text based fasta file in the filename
+   * member variable, like parseTextFasta, but memory maps the file and
+   * parses the proteins in parallel. The sequences of all proteins are
+   * stored in sequence_arena_. Falls back to parseTextFasta if the file
+   * cannot be memory mapped or if using light proteins.
+   * \returns true if success. false if failure.
+   */
+  bool parseMemmapFasta();
+
   /**
    * memory maps the binary fasta file for the database
    *\return true if successfully memory map binary fasta file, else false
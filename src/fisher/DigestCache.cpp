@@ -0,0 +1,212 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include "DigestCache.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <process.h>
+#else
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "InternTable.h"
+
+namespace {
+  const char kMagic[4] = { 'P', 'D', 'C', 'F' };
+  const size_t kHashBufferSize = 1u << 20;
+
+  void writeUInt(std::ostream& os, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; ++i) {
+      os.put(static_cast<char>((value >> (8 * i)) & 0xffu));
+    }
+  }
+
+  bool readUInt(std::istream& is, uint64_t& value, size_t bytes) {
+    value = 0u;
+    for (size_t i = 0; i < bytes; ++i) {
+      int c = is.get();
+      if (c == EOF) return false;
+      value |= static_cast<uint64_t>(c & 0xff) << (8 * i);
+    }
+    return true;
+  }
+
+  void writeString(std::ostream& os, const std::string& s) {
+    writeUInt(os, s.size(), 4);
+    os.write(s.data(), s.size());
+  }
+
+  bool readString(std::istream& is, std::string& s) {
+    uint64_t length;
+    if (!readUInt(is, length, 4)) return false;
+    s.resize(length);
+    return length == 0 || is.read(&s[0], length);
+  }
+
+  /* creates an empty file with a name that starts with prefix and that no
+     other process uses; returns false if it could not be created */
+  bool createTemporaryFile(const std::string& prefix, std::string& fileName) {
+#ifdef _WIN32
+    std::ostringstream name;
+    name << prefix << _getpid() << "." << GetTickCount();
+    fileName = name.str();
+    std::ofstream os(fileName.c_str(), std::ios::binary);
+    return os.is_open();
+#else
+    std::string pattern = prefix + "XXXXXX";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) return false;
+    // mkstemp gives only the owner access, but the cache can be shared
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    close(fd);
+    fileName = &name[0];
+    return true;
+#endif
+  }
+
+  /* replaces the file to with the file from */
+  bool replaceFile(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    // atomic on POSIX: a concurrent reader sees either the old or the new file
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+  }
+
+  void writeMap(std::ostream& os, const std::map<std::string, std::string>& m) {
+    writeUInt(os, m.size(), 4);
+    std::map<std::string, std::string>::const_iterator it;
+    for (it = m.begin(); it != m.end(); ++it) {
+      writeString(os, it->first);
+      writeString(os, it->second);
+    }
+  }
+
+  bool readMap(std::istream& is, std::map<std::string, std::string>& m) {
+    uint64_t size;
+    if (!readUInt(is, size, 4)) return false;
+    std::string key, value;
+    for (uint64_t k = 0; k < size; ++k) {
+      if (!readString(is, key) || !readString(is, value)) return false;
+      m[key] = value;
+    }
+    return true;
+  }
+}
+
+DigestCache::DigestCache(const std::string& cacheDirectory,
+    const std::string& proteinDbFile, ENZYME_T enzyme, DIGEST_T digestion,
+    int minPeptideLength, int maxPeptideLength, int maxMiscleavages,
+    bool generateDecoys, const std::string& decoyPattern) :
+      valid_(false), contentHash_(kFnv1aOffsetBasis) {
+  std::ifstream fasta(proteinDbFile.c_str(), std::ios::binary);
+  if (!fasta.is_open()) return;
+  std::vector<char> buffer(kHashBufferSize);
+  while (fasta.read(&buffer[0], buffer.size()) || fasta.gcount() > 0) {
+    contentHash_ = fnv1a(&buffer[0], fasta.gcount(), contentHash_);
+  }
+
+  std::ostringstream settings;
+  settings << "enzyme=" << enzyme << " digestion=" << digestion
+           << " min-length=" << minPeptideLength
+           << " max-length=" << maxPeptideLength
+           << " miscleavages=" << maxMiscleavages
+           << " decoys=" << generateDecoys
+           << " decoy-pattern=" << decoyPattern;
+  settings_ = settings.str();
+
+  uint64_t key = fnv1a(settings_.data(), settings_.size(), contentHash_);
+  std::ostringstream fileName;
+  fileName << cacheDirectory;
+  if (!cacheDirectory.empty() && cacheDirectory[cacheDirectory.size() - 1] != '/') {
+    fileName << '/';
+  }
+  fileName << "fisher_digest_" << std::hex << key << ".bin";
+  fileName_ = fileName.str();
+  valid_ = true;
+}
+
+bool DigestCache::load(std::map<std::string, std::string>& fragment_map,
+    std::map<std::string, std::string>& duplicate_map) const {
+  if (!valid_) return false;
+  std::ifstream is(fileName_.c_str(), std::ios::binary);
+  if (!is.is_open()) return false;
+
+  char magic[sizeof(kMagic)];
+  uint64_t version, contentHash;
+  std::string settings;
+  if (!is.read(magic, sizeof(kMagic)) ||
+      std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      !readUInt(is, version, 4) || version != kVersion ||
+      !readUInt(is, contentHash, 8) || contentHash != contentHash_ ||
+      !readString(is, settings) || settings != settings_) {
+    return false;
+  }
+
+  // only touch the output once the whole file has been read
+  std::map<std::string, std::string> fragments, duplicates;
+  if (!readMap(is, fragments) || !readMap(is, duplicates)) return false;
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = fragments.begin(); it != fragments.end(); ++it) {
+    fragment_map[it->first] = it->second;
+  }
+  for (it = duplicates.begin(); it != duplicates.end(); ++it) {
+    duplicate_map[it->first] = it->second;
+  }
+  return true;
+}
+
+bool DigestCache::save(const std::map<std::string, std::string>& fragment_map,
+    const std::map<std::string, std::string>& duplicate_map) const {
+  if (!valid_) return false;
+  // write to a temporary file of this run first, so that a concurrent or
+  // interrupted run never sees a partial cache file
+  std::string tmpFileName;
+  if (!createTemporaryFile(fileName_ + ".tmp.", tmpFileName)) return false;
+  {
+    std::ofstream os(tmpFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (os.is_open()) {
+      os.write(kMagic, sizeof(kMagic));
+      writeUInt(os, kVersion, 4);
+      writeUInt(os, contentHash_, 8);
+      writeString(os, settings_);
+      writeMap(os, fragment_map);
+      writeMap(os, duplicate_map);
+      os.close();
+    }
+    if (!os) {
+      std::remove(tmpFileName.c_str());
+      return false;
+    }
+  }
+  if (!replaceFile(tmpFileName, fileName_)) {
+    std::remove(tmpFileName.c_str());
+    return false;
+  }
+  return true;
+}
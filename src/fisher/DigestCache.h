@@ -0,0 +1,62 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class DigestCache, which keeps the protein fragments
+ * and duplicates of a digested database on disk between runs
+ */
+
+#ifndef FISHER_DIGESTCACHE_H_
+#define FISHER_DIGESTCACHE_H_
+
+#ifndef WIN32
+  #include <stdint.h>
+#endif
+
+#include <map>
+#include <string>
+
+#include "objects.h"
+
+/*
+ * The cache file of a database is named after a hash of the contents of the
+ * fasta file and of the digestion settings, which are also stored in the
+ * file and checked when it is loaded. A file that does not match, or that
+ * cannot be read, is treated as a cache miss.
+ */
+class DigestCache {
+ public:
+  DigestCache(const std::string& cacheDirectory,
+    const std::string& proteinDbFile, ENZYME_T enzyme, DIGEST_T digestion,
+    int minPeptideLength, int maxPeptideLength, int maxMiscleavages,
+    bool generateDecoys, const std::string& decoyPattern);
+
+  /* returns false if the database has no valid cache file */
+  bool load(std::map<std::string, std::string>& fragment_map,
+            std::map<std::string, std::string>& duplicate_map) const;
+  bool save(const std::map<std::string, std::string>& fragment_map,
+            const std::map<std::string, std::string>& duplicate_map) const;
+
+  const std::string& getFileName() const { return fileName_; }
+ private:
+  static const uint32_t kVersion = 2u;
+
+  bool valid_;
+  uint64_t contentHash_;
+  std::string settings_, fileName_;
+};
+
+#endif /* FISHER_DIGESTCACHE_H_ */
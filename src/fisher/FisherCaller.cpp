@@ -21,6 +21,12 @@
 
 using namespace std;
 
+// proteins are digested in parallel in chunks of kDigestChunkSize proteins,
+// kDigestChunksPerRound chunks at a time, after which the chunks are merged
+// in protein order
+static const size_t kDigestChunkSize = 128u;
+static const size_t kDigestChunksPerRound = 64u;
+
 FisherCaller::FisherCaller() : enzyme_(TRYPSIN), digestion_(FULL_DIGEST),
     min_peptide_length_(6), max_peptide_length_(50), max_miscleavages_(0),
     decoyPattern_("decoy_") {}
@@ -94,66 +100,39 @@ bool FisherCaller::parseOptions(int argc, char** argv) {
 
 bool FisherCaller::getPeptideProteinMap(Database& db, 
     PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     bool generateDecoys) {
-  std::vector< std::pair<std::string, size_t> > peptideProteinIdxMap;
-  for (size_t protein_idx = 0; protein_idx < db.getNumProteins(); 
-       ++protein_idx) {
-    addProteinToPeptideProteinMap(db, protein_idx, peptide_constraint, 
-        peptide_protein_map, generateDecoys);
-    /*Crux::Protein* protein = db.getProteinAtIdx(protein_idx);
-    
-    if (generateDecoys) {
-      protein->shuffle(PROTEIN_REVERSE_DECOYS);
-      
-      // MT: the crux interface will change the protein identifier. If we are
-      // not inside the crux environment we do this separately here.
-      std::string currentId(protein->getIdPointer());
-      if (currentId.substr(0, decoyPattern_.size()) != decoyPattern_) {
-        currentId = decoyPattern_ + currentId;
-        protein->setId(currentId.c_str());
+  size_t num_proteins = db.getNumProteins();
+  size_t round_size = kDigestChunkSize * kDigestChunksPerRound;
+  for (size_t round_start = 0; round_start < num_proteins; 
+       round_start += round_size) {
+    size_t round_end = std::min(round_start + round_size, num_proteins);
+    int num_chunks = static_cast<int>(
+        (round_end - round_start + kDigestChunkSize - 1) / kDigestChunkSize);
+    std::vector<PeptideProteinIndex> chunk_maps(num_chunks);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      // the constraint keeps a reference count, so every chunk needs its own
+      PeptideConstraint chunk_constraint(peptide_constraint);
+      size_t chunk_start = round_start + chunk * kDigestChunkSize;
+      size_t chunk_end = std::min(chunk_start + kDigestChunkSize, round_end);
+      for (size_t protein_idx = chunk_start; protein_idx < chunk_end; 
+           ++protein_idx) {
+        addProteinToPeptideProteinMap(db, protein_idx, chunk_constraint, 
+            chunk_maps[chunk], generateDecoys);
       }
     }
-    
-    ProteinPeptideIterator cur_protein_peptide_iterator(protein, &peptide_constraint);
-    while (cur_protein_peptide_iterator.hasNext()) {
-      Crux::Peptide* peptide = cur_protein_peptide_iterator.next();
-      std::string sequence(peptide->getSequencePointer(), peptide->getLength());
-      peptideProteinIdxMap.push_back(std::make_pair(sequence,protein_idx));
-      delete peptide;
-    }*/
-  }
-  /*
-  std::string prevPeptide = "";
-  size_t count = 0;
-  std::vector<size_t> proteinIdxs;
-  std::sort(peptideProteinIdxMap.begin(), peptideProteinIdxMap.end());
-  for (size_t i = 0; i < peptideProteinIdxMap.size(); ++i) {
-    if (peptideProteinIdxMap[i].first == prevPeptide) {
-      ++count;
-      proteinIdxs.push_back(peptideProteinIdxMap[i-1].second);
-    } else {
-      if (count > 0) {
-        proteinIdxs.push_back(peptideProteinIdxMap[i-1].second);
-        peptide_protein_map[prevPeptide] = proteinIdxs;
-        proteinIdxs.clear();
-        count = 0;
-      }
-      prevPeptide = peptideProteinIdxMap[i].first;
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+      peptide_protein_map.append(chunk_maps[chunk]);
     }
   }
-  
-  if (count > 0) {
-    proteinIdxs.push_back(peptideProteinIdxMap[i-1].second);
-    peptide_protein_map[prevPeptide] = proteinIdxs;
-  }
-  */
+  peptide_protein_map.finalize();
   return true;
 }
 
 void FisherCaller::addProteinToPeptideProteinMap(Database& db, 
     size_t protein_idx, PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     bool generateDecoys) {
   Crux::Protein* protein = db.getProteinAtIdx(protein_idx);
     
@@ -169,63 +148,131 @@ void FisherCaller::addProteinToPeptideProteinMap(Database& db,
     }
   }
   
-  ProteinPeptideIterator cur_protein_peptide_iterator(protein, &peptide_constraint);
-  while (cur_protein_peptide_iterator.hasNext()) {
-    Crux::Peptide* peptide = cur_protein_peptide_iterator.next();
-    std::string sequence(peptide->getSequencePointer(), peptide->getLength());
-    peptide_protein_map[sequence].push_back(protein_idx);
-    delete peptide;
+  ProteinPeptideIterator cur_protein_peptide_iterator(protein, 
+      &peptide_constraint, protein_idx);
+  PeptideView peptide;
+  while (cur_protein_peptide_iterator.nextView(peptide)) {
+    peptide_protein_map.add(peptide.sequence, peptide.length, 
+        peptide.protein_idx);
   }
 }
 
 bool FisherCaller::getFragmentProteinMap(Database& db, 
     PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     std::map<size_t, std::vector<size_t> >& fragment_protein_map,
     std::map<size_t, size_t>& num_peptides_per_protein) {
-  for (size_t protein_idx = 0; protein_idx < db.getNumProteins(); 
-       ++protein_idx) {
-    addProteinToFragmentProteinMap(db, protein_idx, peptide_constraint,
-        peptide_protein_map, fragment_protein_map, num_peptides_per_protein);
+  // the intersections only read the peptide protein map and can be computed
+  // in parallel, the fragment protein map has to be built in protein order
+  size_t num_proteins = db.getNumProteins();
+  size_t round_size = kDigestChunkSize * kDigestChunksPerRound;
+  std::vector<size_t> num_sequences(round_size);
+  std::vector<std::vector<size_t> > protein_idx_intersections(round_size);
+#pragma omp parallel
+  {
+    std::vector<std::pair<size_t, size_t> > shared_counts(num_proteins);
+    for (size_t round_start = 0; round_start < num_proteins; 
+         round_start += round_size) {
+      size_t round_end = std::min(round_start + round_size, num_proteins);
+      int num_chunks = static_cast<int>(
+          (round_end - round_start + kDigestChunkSize - 1) / kDigestChunkSize);
+#pragma omp for schedule(dynamic, 1)
+      for (int chunk = 0; chunk < num_chunks; ++chunk) {
+        PeptideConstraint chunk_constraint(peptide_constraint);
+        size_t chunk_start = round_start + chunk * kDigestChunkSize;
+        size_t chunk_end = std::min(chunk_start + kDigestChunkSize, round_end);
+        for (size_t protein_idx = chunk_start; protein_idx < chunk_end; 
+             ++protein_idx) {
+          num_sequences[protein_idx - round_start] = getProteinIntersection(db, 
+              protein_idx, chunk_constraint, peptide_protein_map, shared_counts,
+              protein_idx_intersections[protein_idx - round_start]);
+        }
+      }
+#pragma omp single
+      {
+        for (size_t protein_idx = round_start; protein_idx < round_end; 
+             ++protein_idx) {
+          addProteinToFragmentProteinMap(protein_idx, 
+              num_sequences[protein_idx - round_start], 
+              protein_idx_intersections[protein_idx - round_start],
+              fragment_protein_map, num_peptides_per_protein);
+        }
+      }
+    }
   }
   return true;
 }
 
-void FisherCaller::addProteinToFragmentProteinMap(Database& db, 
+/* returns the number of peptides of the protein, and the proteins that
+   contain all of its peptides, stopping as soon as there are less than 2.
+   A protein is listed as many times as it contains the peptide it shares
+   the least often, as with a multiset intersection of the protein lists.
+   shared_counts has an entry for every protein index, which has to be 
+   (0, 0) on entry and is reset to it on return. */
+size_t FisherCaller::getProteinIntersection(Database& db, 
     size_t protein_idx, PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
-    std::map<size_t, std::vector<size_t> >& fragment_protein_map,
-    std::map<size_t, size_t>& num_peptides_per_protein) {
+    const PeptideProteinIndex& peptide_protein_map,
+    std::vector<std::pair<size_t, size_t> >& shared_counts,
+    std::vector<size_t>& protein_idx_intersection) {
   Crux::Protein* protein = db.getProteinAtIdx(protein_idx);
     
   // set new protein peptide iterator
-  ProteinPeptideIterator cur_protein_peptide_iterator(protein, &peptide_constraint);
+  ProteinPeptideIterator cur_protein_peptide_iterator(protein, 
+      &peptide_constraint, protein_idx);
   
-  bool is_first = true;
+  // a single pass over the protein lists of the peptides counts, for every
+  // protein, the number of peptides it shares so far and the least number 
+  // of times it contains one of them. Only the proteins of the first 
+  // peptide can share all peptides, so only their counts are ever set.
+  std::vector<unsigned int> candidates;
   size_t num_sequences = 0;
-  std::vector<size_t> protein_idx_intersection;
-  while (cur_protein_peptide_iterator.hasNext()) {
-    Crux::Peptide* peptide = cur_protein_peptide_iterator.next();
-    std::string sequence(peptide->getSequencePointer(), peptide->getLength());    
-    delete peptide;
+  PeptideView peptide;
+  while (cur_protein_peptide_iterator.nextView(peptide)) {
+    int peptide_idx = peptide_protein_map.find(peptide.sequence, 
+                                               peptide.length);
     ++num_sequences;
     
-    if (is_first) {
-      protein_idx_intersection = peptide_protein_map[sequence];
-      is_first = false;
-    } else {
-      std::vector<size_t> newprotein_idx_intersection(protein_idx_intersection.size());
-      std::vector<size_t>::iterator it = std::set_intersection(
-          protein_idx_intersection.begin(), protein_idx_intersection.end(), 
-          peptide_protein_map[sequence].begin(), peptide_protein_map[sequence].end(), 
-          newprotein_idx_intersection.begin());
-      newprotein_idx_intersection.resize(it - newprotein_idx_intersection.begin());
-      protein_idx_intersection = newprotein_idx_intersection;
+    const unsigned int *proteins_begin = NULL, *proteins_end = NULL;
+    if (peptide_idx != PeptideProteinIndex::kNotFound) {
+      proteins_begin = peptide_protein_map.proteinsBegin(peptide_idx);
+      proteins_end = peptide_protein_map.proteinsEnd(peptide_idx);
     }
     
-    if (protein_idx_intersection.size() < 2) break;
+    size_t num_candidates = 0; // counting repeats
+    for (const unsigned int* it = proteins_begin; it != proteins_end; ) {
+      const unsigned int* run_end = std::upper_bound(it, proteins_end, *it);
+      size_t repeats = static_cast<size_t>(run_end - it);
+      std::pair<size_t, size_t>& counts = shared_counts[*it];
+      if (num_sequences == 1) {
+        counts = std::make_pair(1u, repeats);
+        candidates.push_back(*it);
+      } else if (counts.first + 1 == num_sequences) {
+        counts.first = num_sequences;
+        counts.second = std::min(counts.second, repeats);
+      }
+      if (counts.first == num_sequences) num_candidates += counts.second;
+      it = run_end;
+    }
+    
+    if (num_candidates < 2) break;
   }
   
+  protein_idx_intersection.clear();
+  for (size_t k = 0; k < candidates.size(); ++k) {
+    std::pair<size_t, size_t>& counts = shared_counts[candidates[k]];
+    if (counts.first == num_sequences) {
+      protein_idx_intersection.insert(protein_idx_intersection.end(), 
+          counts.second, candidates[k]);
+    }
+    counts = std::make_pair(0u, 0u);
+  }
+  return num_sequences;
+}
+
+void FisherCaller::addProteinToFragmentProteinMap(size_t protein_idx, 
+    size_t num_sequences, std::vector<size_t>& protein_idx_intersection,
+    std::map<size_t, std::vector<size_t> >& fragment_protein_map,
+    std::map<size_t, size_t>& num_peptides_per_protein) {
   if (protein_idx_intersection.size() > 1) {
     num_peptides_per_protein[protein_idx] = num_sequences;
     std::sort(protein_idx_intersection.begin(), protein_idx_intersection.end()); // sort in descending order
@@ -279,36 +326,72 @@ bool FisherCaller::getProteinFragmentsAndDuplicatesExtraDigest(Database& db,
     std::map<size_t, size_t>& num_peptides_per_protein,
     std::map<std::string, std::string>& fragment_map, 
     std::map<std::string, std::string>& duplicate_map) {
-  bool generateDecoys = false;
+  // the candidate groups are independent of each other; their results are
+  // merged in the order of the groups, so that later groups overwrite
+  // earlier ones as before
+  std::vector<std::map<size_t, std::vector<size_t> >::iterator> groups;
   std::map<size_t, std::vector<size_t> >::iterator it;
   for (it = fragment_protein_map.begin(); it != fragment_protein_map.end(); ++it) {
-    size_t i = it->first;
-    std::map<std::string, std::vector<size_t> > peptide_protein_map;
-    addProteinToPeptideProteinMap(db, i, peptide_constraint, 
-        peptide_protein_map, generateDecoys);
-    for (std::vector<size_t>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
-      size_t j = *it2;
-      if (i != j) {
-        addProteinToPeptideProteinMap(db, j, peptide_constraint, 
-            peptide_protein_map, generateDecoys);
+    groups.push_back(it);
+  }
+  int num_groups = static_cast<int>(groups.size());
+  std::vector<std::map<std::string, std::string> > 
+      group_fragment_maps(num_groups), group_duplicate_maps(num_groups);
+  bool generateDecoys = false;
+#pragma omp parallel
+  {
+    std::vector<std::pair<size_t, size_t> > shared_counts(db.getNumProteins());
+#pragma omp for schedule(dynamic, 1)
+    for (int group = 0; group < num_groups; ++group) {
+      PeptideConstraint group_constraint(peptide_constraint);
+      size_t i = groups[group]->first;
+      const std::vector<size_t>& candidates = groups[group]->second;
+      PeptideProteinIndex peptide_protein_map;
+      addProteinToPeptideProteinMap(db, i, group_constraint, 
+          peptide_protein_map, generateDecoys);
+      for (std::vector<size_t>::const_iterator it2 = candidates.begin(); it2 != candidates.end(); ++it2) {
+        size_t j = *it2;
+        if (i != j) {
+          addProteinToPeptideProteinMap(db, j, group_constraint, 
+              peptide_protein_map, generateDecoys);
+        }
       }
-    }
+      peptide_protein_map.finalize();
     
-    std::map<size_t, std::vector<size_t> > fragment_protein_map_local;
-    std::map<size_t, size_t> num_peptides_per_protein_local;
-    addProteinToFragmentProteinMap(db, i, peptide_constraint, peptide_protein_map, 
-        fragment_protein_map_local, num_peptides_per_protein_local);
-    for (std::vector<size_t>::iterator it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
-      size_t j = *it2;
-      if (i != j) {
-        addProteinToFragmentProteinMap(db, j, peptide_constraint, 
-            peptide_protein_map, fragment_protein_map_local, 
-            num_peptides_per_protein_local);
+      std::map<size_t, std::vector<size_t> > fragment_protein_map_local;
+      std::map<size_t, size_t> num_peptides_per_protein_local;
+      std::vector<size_t> protein_idx_intersection;
+      size_t num_sequences = getProteinIntersection(db, i, group_constraint, 
+          peptide_protein_map, shared_counts, protein_idx_intersection);
+      addProteinToFragmentProteinMap(i, num_sequences, protein_idx_intersection,
+          fragment_protein_map_local, num_peptides_per_protein_local);
+      for (std::vector<size_t>::const_iterator it2 = candidates.begin(); it2 != candidates.end(); ++it2) {
+        size_t j = *it2;
+        if (i != j) {
+          num_sequences = getProteinIntersection(db, j, group_constraint, 
+              peptide_protein_map, shared_counts, protein_idx_intersection);
+          addProteinToFragmentProteinMap(j, num_sequences, 
+              protein_idx_intersection, fragment_protein_map_local, 
+              num_peptides_per_protein_local);
+        }
       }
-    }
     
-    getProteinFragmentsAndDuplicates(db, fragment_protein_map_local, 
-        num_peptides_per_protein_local, fragment_map, duplicate_map);
+      getProteinFragmentsAndDuplicates(db, fragment_protein_map_local, 
+          num_peptides_per_protein_local, group_fragment_maps[group], 
+          group_duplicate_maps[group]);
+    }
+  }
+  
+  for (int group = 0; group < num_groups; ++group) {
+    std::map<std::string, std::string>::const_iterator it2;
+    for (it2 = group_fragment_maps[group].begin(); 
+         it2 != group_fragment_maps[group].end(); ++it2) {
+      fragment_map[it2->first] = it2->second;
+    }
+    for (it2 = group_duplicate_maps[group].begin(); 
+         it2 != group_duplicate_maps[group].end(); ++it2) {
+      duplicate_map[it2->first] = it2->second;
+    }
   }
   return true;
 }
@@ -317,6 +400,50 @@ bool FisherCaller::getProteinFragmentsAndDuplicates(
     std::map<std::string, std::string>& fragment_map,
     std::map<std::string, std::string>& duplicate_map,
     bool generateDecoys) {
+  if (digest_cache_directory_.empty()) {
+    return computeProteinFragmentsAndDuplicates(fragment_map, duplicate_map, 
+                                                generateDecoys);
+  }
+  
+  DigestCache cache(digest_cache_directory_, protein_db_file_, enzyme_, 
+      digestion_, min_peptide_length_, max_peptide_length_, 
+      max_miscleavages_, generateDecoys, decoyPattern_);
+  if (cache.load(fragment_map, duplicate_map)) {
+    if (VERB > 1) {
+      cerr << "Read protein fragments and duplicates from " 
+           << cache.getFileName() << endl;
+    }
+    return EXIT_SUCCESS;
+  }
+  
+  // the cache only holds the proteins of this database, not those already
+  // in the maps
+  std::map<std::string, std::string> fragments, duplicates;
+  bool retVal = computeProteinFragmentsAndDuplicates(fragments, duplicates, 
+                                                     generateDecoys);
+  if (retVal != EXIT_SUCCESS) return retVal;
+  
+  if (!cache.save(fragments, duplicates)) {
+    std::cerr << "Warning: could not write digest cache file " 
+              << cache.getFileName() << std::endl;
+  } else if (VERB > 2) {
+    cerr << "Wrote protein fragments and duplicates to " 
+         << cache.getFileName() << endl;
+  }
+  std::map<std::string, std::string>::const_iterator it;
+  for (it = fragments.begin(); it != fragments.end(); ++it) {
+    fragment_map[it->first] = it->second;
+  }
+  for (it = duplicates.begin(); it != duplicates.end(); ++it) {
+    duplicate_map[it->first] = it->second;
+  }
+  return retVal;
+}
+
+bool FisherCaller::computeProteinFragmentsAndDuplicates(
+    std::map<std::string, std::string>& fragment_map,
+    std::map<std::string, std::string>& duplicate_map,
+    bool generateDecoys) {
   time_t startTime;
   time(&startTime);
   clock_t startClock = clock();
@@ -340,7 +467,7 @@ bool FisherCaller::getProteinFragmentsAndDuplicates(
   // First do a full digest to get candidates for protein grouping
   PeptideConstraint peptide_constraint(enzyme_, FULL_DIGEST, 
       min_peptide_length_, max_peptide_length_, max_miscleavages_);
-  std::map<std::string, std::vector<size_t> > peptide_protein_map;
+  PeptideProteinIndex peptide_protein_map;
   bool success = getPeptideProteinMap(db, peptide_constraint, peptide_protein_map, generateDecoys);
   
   if (!success) {
@@ -31,7 +31,9 @@
 #include <algorithm>
 
 #include "Database.h"
+#include "DigestCache.h"
 #include "PeptideConstraint.h"
+#include "PeptideProteinIndex.h"
 #include "ProteinPeptideIterator.h"
 #include "Protein.h"
 
@@ -55,6 +57,11 @@ class FisherCaller{
   void setFastaDatabase(const std::string& protein_db_file) {
     protein_db_file_ = protein_db_file;
   }
+  /* directory to keep the fragments and duplicates of digested databases
+     in; empty turns the cache off */
+  void setDigestCacheDirectory(const std::string& digest_cache_directory) {
+    digest_cache_directory_ = digest_cache_directory;
+  }
  private:
   ENZYME_T enzyme_;
   DIGEST_T digestion_;
@@ -62,24 +69,34 @@ class FisherCaller{
   std::string decoyPattern_;
   
   std::string protein_db_file_, peptide_input_file_, protein_output_file_;
+  std::string digest_cache_directory_;
+  
+  bool computeProteinFragmentsAndDuplicates(
+    std::map<std::string, std::string>& fragment_map,
+    std::map<std::string, std::string>& duplicate_map,
+    bool generateDecoys);
   
   bool getPeptideProteinMap(Database& db, 
     PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     bool generateDecoys);
   void addProteinToPeptideProteinMap(Database& db, 
     size_t protein_idx, PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     bool generateDecoys);
   
   bool getFragmentProteinMap(Database& db, 
     PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    PeptideProteinIndex& peptide_protein_map,
     std::map<size_t, std::vector<size_t> >& fragment_protein_map,
     std::map<size_t, size_t>& num_peptides_per_protein);
-  void addProteinToFragmentProteinMap(Database& db, 
+  size_t getProteinIntersection(Database& db, 
     size_t protein_idx, PeptideConstraint& peptide_constraint,
-    std::map<std::string, std::vector<size_t> >& peptide_protein_map,
+    const PeptideProteinIndex& peptide_protein_map,
+    std::vector<std::pair<size_t, size_t> >& shared_counts,
+    std::vector<size_t>& protein_idx_intersection);
+  void addProteinToFragmentProteinMap(size_t protein_idx, 
+    size_t num_sequences, std::vector<size_t>& protein_idx_intersection,
     std::map<size_t, std::vector<size_t> >& fragment_protein_map,
     std::map<size_t, size_t>& num_peptides_per_protein);
   
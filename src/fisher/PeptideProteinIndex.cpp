@@ -0,0 +1,114 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+
+#include "PeptideProteinIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace {
+  /* checks a peptide of the index against a sequence */
+  struct SameSequence {
+    const std::vector<char>& arena;
+    const std::vector<size_t>& offsets;
+    const char* sequence;
+    size_t length;
+    SameSequence(const std::vector<char>& a, const std::vector<size_t>& o,
+                 const char* s, size_t l) :
+        arena(a), offsets(o), sequence(s), length(l) {}
+    bool operator()(unsigned int peptide) const {
+      size_t begin = offsets[peptide];
+      return offsets[peptide + 1] - begin == length &&
+             std::memcmp(&arena[begin], sequence, length) == 0;
+    }
+  };
+}
+
+PeptideProteinIndex::PeptideProteinIndex() : sequenceOffsets_(1, 0u),
+    proteinOffsets_(1, 0u) {}
+
+/* returns the index of the peptide, adding it if it is new */
+unsigned int PeptideProteinIndex::insert(const char* sequence, size_t length) {
+  unsigned int newPeptide = static_cast<unsigned int>(getNumPeptides());
+  unsigned int peptide = table_.intern(fnv1a(sequence, length),
+      SameSequence(arena_, sequenceOffsets_, sequence, length), newPeptide);
+  if (peptide == newPeptide) {
+    arena_.insert(arena_.end(), sequence, sequence + length);
+    sequenceOffsets_.push_back(arena_.size());
+  }
+  return peptide;
+}
+
+void PeptideProteinIndex::add(const char* sequence, size_t length,
+                              size_t protein_idx) {
+  occurrences_.push_back(std::make_pair(insert(sequence, length),
+      static_cast<unsigned int>(protein_idx)));
+}
+
+void PeptideProteinIndex::append(const PeptideProteinIndex& other) {
+  // the peptides of the other index are renumbered in their own order, so
+  // that appending the indices of consecutive blocks of proteins gives the
+  // same index as adding all proteins to one
+  std::vector<unsigned int> renumbered(other.getNumPeptides());
+  for (size_t k = 0; k < other.getNumPeptides(); ++k) {
+    size_t begin = other.sequenceOffsets_[k];
+    renumbered[k] = insert(&other.arena_[begin],
+                           other.sequenceOffsets_[k + 1] - begin);
+  }
+  occurrences_.reserve(occurrences_.size() + other.occurrences_.size());
+  for (size_t k = 0; k < other.occurrences_.size(); ++k) {
+    occurrences_.push_back(std::make_pair(
+        renumbered[other.occurrences_[k].first], other.occurrences_[k].second));
+  }
+}
+
+void PeptideProteinIndex::finalize() {
+  // counting sort of the occurrences by peptide, which keeps the proteins of
+  // each peptide in the order they were added
+  size_t numPeptides = getNumPeptides();
+  proteinOffsets_.assign(numPeptides + 1, 0u);
+  for (size_t k = 0; k < occurrences_.size(); ++k) {
+    ++proteinOffsets_[occurrences_[k].first + 1];
+  }
+  for (size_t k = 0; k < numPeptides; ++k) {
+    proteinOffsets_[k + 1] += proteinOffsets_[k];
+  }
+  std::vector<size_t> fill(proteinOffsets_.begin(), proteinOffsets_.end() - 1);
+  proteins_.resize(occurrences_.size());
+  for (size_t k = 0; k < occurrences_.size(); ++k) {
+    proteins_[fill[occurrences_[k].first]++] = occurrences_[k].second;
+  }
+  std::vector<std::pair<unsigned int, unsigned int> >().swap(occurrences_);
+  
+  // proteins added out of order have to be sorted for the intersections
+  std::vector<unsigned int>::iterator begin = proteins_.begin();
+  for (size_t k = 0; k < numPeptides; ++k) {
+    std::vector<unsigned int>::iterator first = begin + proteinOffsets_[k];
+    std::vector<unsigned int>::iterator last = begin + proteinOffsets_[k + 1];
+    if (std::adjacent_find(first, last, std::greater<unsigned int>()) != last) {
+      std::sort(first, last);
+    }
+  }
+}
+
+int PeptideProteinIndex::find(const char* sequence, size_t length) const {
+  unsigned int peptide = table_.find(fnv1a(sequence, length),
+      SameSequence(arena_, sequenceOffsets_, sequence, length));
+  return peptide == InternTable::kNoId ?
+      kNotFound : static_cast<int>(peptide);
+}
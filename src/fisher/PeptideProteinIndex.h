@@ -0,0 +1,76 @@
+/*******************************************************************************
+ Copyright 2006-2012 Lukas Käll <lukas.kall@scilifelab.se>
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+
+ *******************************************************************************/
+/*
+ * This file stores the class PeptideProteinIndex, which maps the digested
+ * peptides of a protein database to the proteins they occur in
+ */
+
+#ifndef FISHER_PEPTIDEPROTEININDEX_H_
+#define FISHER_PEPTIDEPROTEININDEX_H_
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+#include "InternTable.h"
+
+/*
+ * The peptide sequences are stored once, back to back in a single arena, and
+ * found through an InternTable of their FNV-1a hashes; a hash match is
+ * verified against the arena. After finalize(), the proteins of
+ * every peptide are a contiguous range of a single array (CSR form), sorted
+ * by protein index, including repeats.
+ */
+class PeptideProteinIndex {
+ public:
+  static const int kNotFound = -1;
+
+  PeptideProteinIndex();
+
+  /* records an occurrence of the peptide in the protein; only allowed
+     before finalize() */
+  void add(const char* sequence, size_t length, size_t protein_idx);
+  /* records the occurrences of another index after the ones of this one;
+     only allowed before finalize() on either */
+  void append(const PeptideProteinIndex& other);
+  /* builds the protein lists of the peptides */
+  void finalize();
+
+  /* returns the index of the peptide, or kNotFound */
+  int find(const char* sequence, size_t length) const;
+
+  size_t getNumPeptides() const { return sequenceOffsets_.size() - 1; }
+  const unsigned int* proteinsBegin(int peptide) const {
+    return &proteins_[0] + proteinOffsets_[peptide];
+  }
+  const unsigned int* proteinsEnd(int peptide) const {
+    return &proteins_[0] + proteinOffsets_[peptide + 1];
+  }
+
+ private:
+  InternTable table_;
+  std::vector<char> arena_;
+  std::vector<size_t> sequenceOffsets_;
+  /* (peptide, protein) pairs, only kept until finalize() */
+  std::vector<std::pair<unsigned int, unsigned int> > occurrences_;
+  std::vector<size_t> proteinOffsets_;
+  std::vector<unsigned int> proteins_;
+
+  unsigned int insert(const char* sequence, size_t length);
+};
+
+#endif /* FISHER_PEPTIDEPROTEININDEX_H_ */
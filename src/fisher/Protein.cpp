@@ -12,6 +12,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <vector>
+#include <algorithm>
 
 #include "Protein.h"
 #include "Peptide.h"
@@ -40,6 +41,7 @@ void Protein::init() {
   protein_idx_ = 0;
   is_light_ = false;
   is_memmap_ = false;
+  owns_sequence_ = true;
   id_ = NULL;
   sequence_ = NULL;
   length_ = 0;
@@ -108,7 +110,7 @@ Protein::~Protein()
     if (id_ != NULL){
       free(id_);
     }
-    if (sequence_ != NULL){
+    if (sequence_ != NULL && owns_sequence_){
       free(sequence_);
     }
     if (annotation_ != NULL){
@@ -377,6 +379,91 @@ bool Protein::parseProteinFastaFile(
 
 }
 
+/**
+ * \returns the first character after the title line of a FASTA record
+ */
+static const char* fastaRecordSequenceStart(
+  const char* record, ///< start of the record -in
+  const char* record_end ///< end of the record -in
+  )
+{
+  const char* line_end = 
+    (const char*)memchr(record + 1, '\n', record_end - (record + 1));
+  return (line_end == NULL) ? record_end : line_end + 1;
+}
+
+/**
+ * Counts the letters after the title line, which parseProteinFastaRecord
+ * makes the sequence of.
+ */
+unsigned int Protein::fastaRecordSequenceLength(
+  const char* record, ///< start of the record -in
+  const char* record_end ///< end of the record -in
+  )
+{
+  unsigned int sequence_length = 0;
+  for (const char* pos = fastaRecordSequenceStart(record, record_end); 
+       pos < record_end; ++pos) {
+    if (isalpha((unsigned char)*pos)) {
+      ++sequence_length;
+    }
+  }
+  return sequence_length;
+}
+
+/**
+ * Parses a protein from a FASTA record in memory. Follows readTitleLine
+ * and readRawSequence: the id is the first word of the title line, as far
+ * as it fits in LONGEST_LINE, and the sequence consists of the letters up
+ * to the next '>', in upper case. Unlike readRawSequence, there is no limit
+ * on the length of the sequence.
+ * \returns TRUE if the title line has an id. FALSE otherwise.
+ */
+bool Protein::parseProteinFastaRecord(
+  const char* record, ///< start of the record -in
+  const char* record_end, ///< end of the record -in
+  char* sequence_buffer, ///< where to write the sequence -out
+  unsigned long offset ///< file offset of the record -in
+  )
+{
+  char id_line[LONGEST_LINE];
+  char name[LONGEST_LINE];
+
+  // the title line, without the '>' and the last character (the newline)
+  const char* line = record + 1;
+  const char* line_end = fastaRecordSequenceStart(record, record_end);
+  size_t line_length = 
+    std::min((size_t)(line_end - line), (size_t)(LONGEST_LINE - 1));
+  memcpy(id_line, line, line_length);
+  id_line[line_length] = '\0';
+  if (line_length > 0) {
+    id_line[line_length - 1] = '\0';
+  }
+
+  bool has_id = (sscanf(id_line, "%s", name) == 1);
+  if (has_id) {
+    setId(name);
+  }
+
+  unsigned int sequence_length = 0;
+  for (const char* pos = line_end; pos < record_end; ++pos) {
+    int a_char = (unsigned char)*pos;
+    if (isalpha(a_char)) {
+      a_char = toupper(a_char);
+      if (a_char < 65 || a_char > 90) {
+        a_char = 'X';
+      }
+      sequence_buffer[sequence_length++] = a_char;
+    }
+  }
+  sequence_buffer[sequence_length] = '\0';
+
+  setSequencePointer(sequence_buffer, sequence_length);
+  offset_ = offset;
+  setIsLight(false);
+  return has_id;
+}
+
 /**************************************************/
 
 /**
@@ -640,7 +727,10 @@ void Protein::setSequence(
   )
 {
 
-  free(sequence_);
+  if (owns_sequence_) {
+    free(sequence_);
+  }
+  owns_sequence_ = true;
   unsigned int sequence_length = strlen(sequence) +1; // +\0
   char * copy_sequence = 
     (char *)malloc(sizeof(char)*sequence_length);
@@ -648,6 +738,22 @@ void Protein::setSequence(
     strncpy(copy_sequence, sequence, sequence_length);  
 }
 
+/**
+ * sets the sequence of the protein to storage it does not own
+ */
+void Protein::setSequencePointer(
+  char* sequence, ///< the sequence -in
+  unsigned int length ///< the length of the sequence -in
+  )
+{
+  if (owns_sequence_) {
+    free(sequence_);
+  }
+  owns_sequence_ = false;
+  sequence_ = sequence;
+  length_ = length;
+}
+
 /**
  *\returns the length of the protein
  * assumes that the protein is heavy
@@ -26,6 +26,7 @@ class Protein {
   unsigned int protein_idx_; ///< The index of the protein in it's database.
   bool    is_light_; ///< is the protein a light protein?
   bool    is_memmap_; ///< is the protein produced from memory mapped file
+  bool    owns_sequence_; ///< should the sequence be freed with the protein
   char*              id_; ///< The protein sequence id.
   char*        sequence_; ///< The protein sequence.
   unsigned int   length_; ///< The length of the protein sequence.
@@ -151,6 +152,31 @@ class Protein {
     FILE* file ///< fasta file -in
   );
 
+  /**
+   * \returns the length of the sequence parseProteinFastaRecord parses from
+   * a FASTA record in memory
+   */
+  static unsigned int fastaRecordSequenceLength(
+    const char* record, ///< start of the record -in
+    const char* record_end ///< end of the record -in
+  );
+
+  /**
+   * Parses a protein from a FASTA record in memory, from its '>' up to the
+   * next record, in the same way as parseProteinFastaFile. The sequence is
+   * written to sequence_buffer, which must have room for
+   * fastaRecordSequenceLength characters and a terminating null, and is
+   * not owned by the protein.
+   * \returns TRUE if the title line has an id. FALSE if it has none, in
+   * which case the id is not set.
+   */
+  bool parseProteinFastaRecord(
+    const char* record, ///< start of the record -in
+    const char* record_end, ///< end of the record -in
+    char* sequence_buffer, ///< where to write the sequence -out
+    unsigned long offset ///< file offset of the record -in
+  );
+
   /**
    * Parses a protein from an memory mapped binary fasta file
    * the protein_idx field of the protein must be added before or
@@ -225,6 +251,15 @@ class Protein {
     const char* sequence ///< the sequence to add -in
   );
 
+  /**
+   * sets the sequence of the protein to storage it does not own, such as
+   * the sequence arena of its database
+   */
+  void setSequencePointer(
+    char* sequence, ///< the sequence -in
+    unsigned int length ///< the length of the sequence -in
+  );
+
   /**
    *\returns the length of the protein
    */
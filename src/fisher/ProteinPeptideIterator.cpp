@@ -368,12 +368,14 @@ unsigned int ProteinPeptideIterator::countMaxPeptides(
  */
 ProteinPeptideIterator::ProteinPeptideIterator(
   Protein* protein, ///< the protein's peptide to iterate -in
-  PeptideConstraint* peptide_constraint ///< the peptide constraints -in
+  PeptideConstraint* peptide_constraint, ///< the peptide constraints -in
+  size_t protein_idx ///< the index of the protein, reported in views -in
   )
 {
 
   // initialize iterator
   protein_ = NULL;
+  protein_idx_ = protein_idx;
   cur_start_ = 0;
   cur_length_ = 1;
   peptide_idx_ = 0;
@@ -456,6 +458,36 @@ Crux::Peptide* ProteinPeptideIterator::next()
   return peptide;
 }
 
+/**
+ * Fills in the view of the next peptide in the protein, in the same order
+ * as next()
+ * \returns false if there are no more peptides
+ */
+bool ProteinPeptideIterator::nextView(PeptideView& view)
+{
+  if( !has_next_){
+    return false;
+  }
+
+  int cleavage_idx = current_cleavage_idx_;
+  int current_start = (*nterm_cleavage_positions_)[cleavage_idx];
+  int current_length = (*peptide_lengths_)[cleavage_idx];
+
+  view.protein_idx = protein_idx_;
+  view.start = current_start;
+  view.length = current_length;
+  // same count of skipped cleavages as used in selectPeptides
+  view.missed_cleavages = 
+    (*cumulative_cleavages_)[current_start + current_length - 2] - 
+    (*cumulative_cleavages_)[current_start - 1];
+  view.sequence = protein_->getSequencePointer(current_start - 1);
+
+  // update position of iterator
+  ++current_cleavage_idx_;
+  has_next_ = (current_cleavage_idx_ != num_cleavages_);
+  return true;
+}
+
 /**
  *\returns the protein that the iterator was created on
  */
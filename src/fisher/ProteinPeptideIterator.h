@@ -16,13 +16,27 @@
 #include "Peptide.h"
 #include "PeptideConstraint.h"
 
+#include <cstddef>
 #include <iterator>
 #include <vector>
 
+/**
+ * A peptide given by its position in the sequence of its protein, so that
+ * it can be iterated over without creating a Peptide object.
+ */
+struct PeptideView {
+  size_t protein_idx; ///< The index of the protein, as given to the iterator.
+  int start; ///< Start in protein of the peptide. 1st aa is 1.
+  int length; ///< The length of the peptide.
+  int missed_cleavages; ///< The number of internal enzyme cleavage sites.
+  const char* sequence; ///< Points into the protein, not null terminated.
+};
+
 class ProteinPeptideIterator {
 
  protected:
   Crux::Protein* protein_; ///< The protein whose peptides to iterate over. 
+  size_t protein_idx_; ///< The index of the protein, only used for views.
   unsigned short int cur_start_; ///< Start in protein of the current peptide.
   unsigned short int cur_length_; ///< The length of the current peptide.
   unsigned int peptide_idx_; ///< The index of the current peptide.
@@ -116,7 +130,8 @@ class ProteinPeptideIterator {
    */
   ProteinPeptideIterator(
     Crux::Protein* protein,
-    PeptideConstraint* peptide_constraint
+    PeptideConstraint* peptide_constraint,
+    size_t protein_idx = 0
   );
 
   /**
@@ -135,6 +150,14 @@ class ProteinPeptideIterator {
    */
   Crux::Peptide* next();
 
+  /**
+   * Moves to the next peptide, in the same order as next(), without any
+   * allocation. The view stays valid as long as the protein sequence does.
+   * \returns false if there are no more peptides, in which case the view
+   * is left untouched
+   */
+  bool nextView(PeptideView& view);
+
   /**
    *\returns the protein that the iterator was created on
    */